@@ -3,6 +3,7 @@
 // Grid stuff
 
 #include <algorithm>
+#include <barrier>
 #include <concepts>
 #include <cstdint>
 #include <cstdlib>
@@ -11,13 +12,17 @@
 #include <iostream>
 #include <iterator>
 #include <numeric>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "grid.h"
+
 // config
 
 static const bool g_show_input = false;
@@ -25,149 +30,134 @@ static const bool g_show_dirs = false;
 static const bool g_show_steps = false;
 static const bool g_show_final = false;
 static const std::uint_least64_t g_max_cycles = 1'000'000'000;
+static const int g_parallel_min_extent = 512; // smaller boards stay serial
+static const unsigned g_max_threads = 0;       // 0 for hardware_concurrency
+static const int g_line_block = 64;            // threads get multiples of this many lines
 
 // common types
 
 using std::as_const;
 using std::vector;
 
-enum class Dir { west, east, north, south };
-
-// coordinate system:
-// leftmost character is 0, increases by 1 each character going to the right
-// topmost character is 0, increases by 1 each additional line down
-template <std::integral T>
-struct grid
-{
-    using container_t = vector<char>;
-    using pos_t       = T;
-    using bounds_t    = std::tuple<pos_t, pos_t, int>; // start, end, step
-
-    void add_line(const std::string &line);
-
-    bounds_t steps_for_dir(const pos_t pos, const Dir dir) const;
-    container_t extract_line(const pos_t pos, const Dir dir) const;
-    void set_line(const container_t &line, const pos_t pos, const Dir dir);
-
-    void fall(Dir dir);
-
-    pos_t height() const { return m_height; }
-    pos_t width() const { return m_width; }
-    std::string_view view() const { return std::string_view(m_grid.data(), m_width * m_height); }
-
-    void dump_grid() const;
+// Rows are padded with walls to a whole number of cache lines, so the blocks
+// of g_line_block columns that spin_pool hands out for north and south never
+// share a cache line between threads.
+using board = grid<std::uint16_t, 0, 0, row_padding<64, '#'>>;
 
-public:
-    container_t m_grid;
-    pos_t m_width = 0, m_height = 0;
-};
+static const Dir g_cycle_dirs[] = { Dir::north, Dir::west, Dir::south, Dir::east };
 
-template <std::integral T>
-void grid<T>::add_line(const std::string &line)
+// number of lines that fall() works on for dir
+template <class Grid>
+static auto num_lines(const Grid &g, Dir dir)
 {
-    if(!m_width) { m_width = line.size(); }
-    std::copy(line.begin(), line.end(), std::back_inserter(m_grid));
-    m_height++;
+    return (dir == Dir::north || dir == Dir::south) ? g.width() : g.height();
 }
 
-template <std::integral T>
-void grid<T>::dump_grid() const
+// make the rounded rocks in lines [first, last) roll as far as they can
+// towards dir
+template <class Grid>
+static void fall(Grid &g, Dir dir, typename Grid::pos_t first, typename Grid::pos_t last)
 {
-    using std::cout;
-    cout << "grid: " << m_width << "x" << m_height << "\n";
-    for(pos_t row = 0; row < m_height; row++) {
-        const auto it = &m_grid[row * m_width];
-        std::copy(it, it + m_width, std::ostream_iterator<char>(cout));
-        cout << "\n";
-    }
-}
+    using std::find;
+    using pos_t = typename Grid::pos_t;
 
-// common code for iterating across a column or row
-template <std::integral T>
-auto grid<T>::steps_for_dir(const pos_t pos, const Dir dir) const
-    -> bounds_t
-{
-    pos_t start = 0, end = 0;
-    int stride = 1; // can be negative
-
-    // we will iterate up to AND INCLUDING the end
-    if (dir == Dir::east || dir == Dir::west) {
-        start = pos * m_width;
-        end = (pos + 1) * m_width - 1;
-    } else {
-        start = pos;
-        end = pos + m_width * (m_height - 1);
-        stride = m_width;
-    }
+    for (pos_t i = first; i < last; i++) {
+        // the line we extract has position 0 farther AWAY from the given dir
+        // and position foo.size() - 1 farthest TOWARDS.
+        // So to make rocks 'O' fall NORTH (dir == dir::north), we must push
+        // them to the far right of the array.
+        auto l = g.extract_line(i, dir);
 
-    if (dir == Dir::north || dir == Dir::west) {
-        stride *= -1;
-        std::swap(start, end);
-    }
+        // sort in areas between boulders '#'
+        auto start_pos = find_if(l.begin(), l.end(), [](const auto &v) { return v != '#'; });
+        auto end_pos = find(start_pos, l.end(), '#');
+        while(start_pos != l.end() || end_pos != l.end()) {
+            sort(start_pos, end_pos); // take advantage that '.' < 'O'
 
-    end += stride; // so we can abort as soon as we see this
+            start_pos = find_if(end_pos, l.end(), [](const auto &v) { return v != '#'; });
+            end_pos = find(start_pos, l.end(), '#');
+        }
 
-    return std::make_tuple(start, end, stride);
+        g.set_line(l, i, dir);
+    }
 }
 
-template <std::integral T>
-auto grid<T>::extract_line(const pos_t pos, const Dir dir) const
-    -> container_t
+// make the rounded rocks of the grid all roll as far as they can towards dir
+template <class Grid>
+static void fall(Grid &g, Dir dir)
 {
-    container_t result;
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    for (pos_t i = start; i != end; i += stride) {
-        result.push_back(m_grid[i]);
-    }
-
-    return result;
+    fall(g, dir, 0, num_lines(g, dir));
 }
 
-template <std::integral T>
-void grid<T>::set_line(const container_t &line, const pos_t pos, const Dir dir)
+// Runs spin cycles with the lines of each direction split across threads. Each
+// thread gets one block of adjacent lines (so neighbouring threads only meet
+// at block edges) and all of them wait at a barrier before the next direction
+// starts. The calling thread does block 0.
+template <class Grid>
+class spin_pool
 {
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
+    public:
+    spin_pool(Grid &g, unsigned num_threads)
+        : m_g(g), m_num_threads(num_threads), m_sync(num_threads)
+    {
+        for (unsigned t = 1; t < m_num_threads; t++) {
+            m_workers.emplace_back([this, t] { worker(t); });
+        }
+    }
 
-    auto it = line.begin();
-    for (pos_t i = start; i != end; i += stride) {
-        m_grid[i] = *it++;
+    ~spin_pool()
+    {
+        m_stop = true;
+        m_sync.arrive_and_wait(); // workers see m_stop and exit, then get joined
     }
-}
 
-template <std::integral T>
-void grid<T>::fall(Dir dir)
-{
-    using std::find;
+    spin_pool(const spin_pool &) = delete;
+    spin_pool &operator=(const spin_pool &) = delete;
 
-    const pos_t max_extent =
-        (dir == Dir::north || dir == Dir::south)
-            ? m_height
-            : m_width;
+    // one full spin cycle, returns once every thread has finished it
+    void spin()
+    {
+        m_sync.arrive_and_wait();
+        run_cycle(0);
+    }
 
-    for (pos_t i = 0; i < max_extent; i++) {
-        // the line we extract has position 0 farther AWAY from the given dir
-        // and position foo.size() - 1 farthest TOWARDS.
-        // So to make rocks 'O' fall NORTH (dir == dir::north), we must push
-        // them to the far right of the array.
-        auto l = this->extract_line(i, dir);
+    private:
+    void run_cycle(unsigned t)
+    {
+        for (const Dir dir : g_cycle_dirs) {
+            // in size_t so that block * t can't wrap pos_t
+            const std::size_t n = num_lines(m_g, dir);
+            std::size_t block = (n + m_num_threads - 1) / m_num_threads;
+            block = (block + g_line_block - 1) / g_line_block * g_line_block;
 
-        // sort in areas between boulders '#'
-        auto start_pos = find_if(l.begin(), l.end(), [](const auto &v) { return v != '#'; });
-        auto end_pos = find(start_pos, l.end(), '#');
-        while(start_pos != l.end() || end_pos != l.end()) {
-            sort(start_pos, end_pos); // take advantage that '.' < 'O'
+            const std::size_t first = std::min(n, block * t);
+            const std::size_t last = std::min(n, first + block);
+            fall(m_g, dir, typename Grid::pos_t(first), typename Grid::pos_t(last));
 
-            start_pos = find_if(end_pos, l.end(), [](const auto &v) { return v != '#'; });
-            end_pos = find(start_pos, l.end(), '#');
+            m_sync.arrive_and_wait();
         }
+    }
 
-        this->set_line(l, i, dir);
+    void worker(unsigned t)
+    {
+        while (true) {
+            m_sync.arrive_and_wait(); // wait for spin()
+            if (m_stop) {
+                return;
+            }
+            run_cycle(t);
+        }
     }
-}
 
-template <typename T>
-static int load_factor(const grid<T> &g, const Dir dir)
+    Grid &m_g;
+    const unsigned m_num_threads;
+    std::barrier<> m_sync;
+    bool m_stop = false;
+    std::vector<std::jthread> m_workers; // last, so that they're joined first
+};
+
+template <class Grid>
+static int load_factor(const Grid &g, const Dir dir)
 {
     // TODO: Hardcoded for north-facing only
     vector<int> weights(g.height(), 0);
@@ -213,7 +203,7 @@ int main(int argc, char **argv)
     ifstream input;
     input.exceptions(ifstream::badbit);
 
-    grid<std::uint16_t> g;
+    board g;
 
     try {
         input.open(argv[1]);
@@ -253,13 +243,23 @@ int main(int argc, char **argv)
         }
     }
 
+    // Big boards spread each tilt over threads
+    const unsigned num_threads = g_max_threads ? g_max_threads : std::thread::hardware_concurrency();
+    std::optional<spin_pool<decltype(g)>> pool;
+    if (num_threads > 1 && std::max(g.width(), g.height()) >= g_parallel_min_extent) {
+        pool.emplace(g, num_threads);
+    }
+
     // Do the spin cycles but look for a shortcut to abort early.
     std::unordered_map<std::size_t, std::uint_least64_t> cache;
     for (std::uint_least64_t i = 0; i < g_max_cycles; i++) {
-        g.fall(Dir::north);
-        g.fall(Dir::west);
-        g.fall(Dir::south);
-        g.fall(Dir::east); // spin cycle!
+        if (pool) {
+            pool->spin();
+        } else {
+            for (const Dir dir : g_cycle_dirs) {
+                fall(g, dir); // spin cycle!
+            }
+        }
 
         if constexpr (g_show_steps) {
             cout << "After cycle " << i << "\n";
@@ -17,10 +17,11 @@
 #include <string>
 #include <string_view>
 #include <tuple>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "grid.h"
+
 // config
 
 static const bool g_show_input = false;
@@ -32,10 +33,8 @@ static const bool g_debug_log  = false;
 using std::as_const;
 using std::pair;
 using std::tuple;
-using std::unordered_map;
 using std::vector;
 
-enum class Dir { west, east, north, south };
 using pos_t = uint16_t;
 
 struct node
@@ -48,128 +47,52 @@ struct node
     bool operator==(const node& o) const = default;
 };
 
-template<>
-struct std::hash<node>
-{
-    std::size_t operator()(const node& n) const noexcept
-    {
-        std::size_t h1 = std::hash<pos_t>{}(n.row);
-        std::size_t h2 = std::hash<pos_t>{}(n.col);
-        std::size_t h3 = std::hash<int>{}(n.consec_step);
-        std::size_t h4 = std::hash<Dir>{}(n.dir_in);
-
-        return h1 ^ (h2 << 1) ^ (h3 << 2) ^ (h4 << 3);
-    }
-};
-
-// coordinate system:
-// leftmost character is 0, increases by 1 each character going to the right
-// topmost character is 0, increases by 1 each additional line down
-template <std::integral T>
-struct grid
+// Shortest and longest straight run allowed before turning.
+struct run_rules
 {
-    using container_t = vector<char>;
-    using pos_t       = T;
-    using bounds_t    = std::tuple<pos_t, pos_t, int>; // start, end, step
-
-    void add_line(const std::string &line);
-
-    bounds_t steps_for_dir(const pos_t pos, const Dir dir) const;
-    container_t extract_line(const pos_t pos, const Dir dir) const;
-    void set_line(const container_t &line, const pos_t pos, const Dir dir);
-    char at(const pos_t col, const pos_t row) const;
-
-    pos_t height() const { return m_height; }
-    pos_t width() const { return m_width; }
-    std::string_view view() const { return std::string_view(m_grid.data(), m_width * m_height); }
+    int min_run, max_run;
 
-    void dump_grid() const;
-
-    public:
-    container_t m_grid;
-    pos_t m_width = 0, m_height = 0;
+    bool operator==(const run_rules &) const = default;
 };
 
-//{{{
-template <std::integral T>
-void grid<T>::add_line(const std::string &line)
-{
-    if(!m_width) { m_width = line.size(); }
-    std::copy(line.begin(), line.end(), std::back_inserter(m_grid));
-    m_height++;
-}
+static constexpr run_rules g_part1_rules { 1, 3 };
+static constexpr run_rules g_part2_rules { 4, 10 };
 
-template <std::integral T>
-void grid<T>::dump_grid() const
-{
-    using std::cout;
-    cout << "grid: " << m_width << "x" << m_height << "\n";
-    for(pos_t row = 0; row < m_height; row++) {
-        const auto it = &m_grid[row * m_width];
-        std::copy(it, it + m_width, std::ostream_iterator<char>(cout));
-        cout << "\n";
-    }
-}
+// A node packed into 32 bits: ((row * W + col) * 4 + dir_in) * (max_steps + 1)
+// + consec_step. Queue entries are (distance, state_id), 8 bytes.
+using state_id = uint32_t;
 
-// common code for iterating across a column or row
-template <std::integral T>
-auto grid<T>::steps_for_dir(const pos_t pos, const Dir dir) const
--> bounds_t
+// Every node gets a slot in flat per-state arrays. consec_step is
+// 0..max_steps so there are 4 * (max_steps + 1) states per cell. MaxSteps of 0
+// means it's only known at runtime.
+template <int MaxSteps>
+struct state_space
 {
-    pos_t start = 0, end = 0;
-    int stride = 1; // can be negative
+    static constexpr state_id none = std::numeric_limits<state_id>::max();
 
-    // we will iterate up to AND INCLUDING the end
-    if (dir == Dir::east || dir == Dir::west) {
-        start = pos * m_width;
-        end = (pos + 1) * m_width - 1;
-    } else {
-        start = pos;
-        end = pos + m_width * (m_height - 1);
-        stride = m_width;
-    }
+    uint32_t W, H;
+    int runtime_max_steps;
 
-    if (dir == Dir::north || dir == Dir::west) {
-        stride *= -1;
-        std::swap(start, end);
+    int max_steps() const {
+        if constexpr (MaxSteps != 0) { return MaxSteps; }
+        return runtime_max_steps;
     }
 
-    end += stride; // so we can abort as soon as we see this
-
-    return std::make_tuple(start, end, stride);
-}
-
-template <std::integral T>
-auto grid<T>::extract_line(const pos_t pos, const Dir dir) const
--> container_t
-{
-    container_t result;
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
+    std::size_t size() const { return std::size_t(W) * H * 4 * (max_steps() + 1); }
 
-    for (pos_t i = start; i != end; i += stride) {
-        result.push_back(m_grid[i]);
+    state_id index(const node &n) const {
+        return ((state_id(n.row) * W + n.col) * 4 + state_id(n.dir_in)) * (max_steps() + 1) + n.consec_step;
     }
 
-    return result;
-}
-
-template <std::integral T>
-void grid<T>::set_line(const container_t &line, const pos_t pos, const Dir dir)
-{
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    auto it = line.begin();
-    for (pos_t i = start; i != end; i += stride) {
-        m_grid[i] = *it++;
+    node at(state_id i) const {
+        node n;
+        n.consec_step = i % (max_steps() + 1); i /= (max_steps() + 1);
+        n.dir_in = static_cast<Dir>(i % 4);  i /= 4;
+        n.col = i % W;
+        n.row = i / W;
+        return n;
     }
-}
-
-template <std::integral T>
-char grid<T>::at(const pos_t col, const pos_t row) const
-{
-    return m_grid[row * m_width + col];
-}
-//}}}
+};
 
 static const char *dir_name(Dir d)
 {
@@ -193,86 +116,49 @@ std::ostream& operator <<(std::ostream &os, const node &n)
     return os;
 }
 
-int main(int argc, char **argv)
+// MinRun/MaxRun of 0 means the rules are only known at runtime, otherwise the
+// state space and run checks are compile-time constants.
+template <int MinRun, int MaxRun>
+static void solve(const grid<uint16_t> &g, const run_rules rules)
 {
-    using std::cerr;
     using std::cout;
-    using std::endl;
-    using std::ifstream;
-    using std::string;
-
-    if (argc < 2) {
-        std::cerr << "Enter a file to read\n";
-        return 1;
-    }
-
-    ifstream input;
-    input.exceptions(ifstream::badbit);
-
-    grid<std::uint16_t> g;
-
-    try {
-        input.open(argv[1]);
-        string line;
-        while (!input.eof() && std::getline(input, line)) {
-            g.add_line(line);
-        }
-
-        input.close();
-    }
-    catch (ifstream::failure &e) {
-        cerr << "Exception on reading input: " << e.what() << endl;
-        return 1;
-    }
-    catch (...) {
-        cerr << "Something else went wrong..." << endl;
-        return 1;
-    }
-
-    if constexpr (g_show_input) {
-        g.dump_grid();
-        cout << "\n";
-    }
 
     std::ofstream dbg;
     dbg.open(g_debug_log ? "debug.log" : "/dev/null");
 
     const auto W = g.width(), H = g.height();
 
-    unordered_map<node, int> distances;
-    unordered_map<node, bool> was_visited;
-    unordered_map<node, node> predecessors;
+    const state_space<MaxRun> states { W, H, rules.max_run };
+    const int min_run = MaxRun ? MinRun : rules.min_run;
+    const int inf = std::numeric_limits<int>::max();
 
-    const auto node_distance_compare = [&distances](const node &l, const node &r) {
-        const auto lnode = distances.find(l);
-        const auto rnode = distances.find(r);
-        const auto end = distances.end();
-        const auto m = std::numeric_limits<int>::max();
-        return ((lnode != end) ? lnode->second : m)
-             > ((rnode != end) ? rnode->second : m);
-    };
+    vector<int> distances(states.size(), inf);
+    vector<bool> was_visited(states.size(), false);
+    vector<state_id> predecessors(states.size(), decltype(states)::none);
 
-    std::priority_queue<
-        node, vector<node>,
-        decltype(node_distance_compare)
-        > to_visit(node_distance_compare);
+    // (distance, state index) so that ordering never needs a lookup
+    using queue_entry = pair<int, state_id>;
+    std::priority_queue<queue_entry, vector<queue_entry>, std::greater<queue_entry>> to_visit;
 
     node start { };
-    distances[start] = 0;
+    distances[states.index(start)] = 0;
 
-    to_visit.push(start);
+    to_visit.emplace(0, states.index(start));
 
     while(!to_visit.empty()) {
         using enum Dir;
 
-        node cur = to_visit.top();
+        const auto [cur_dist, cur_idx] = to_visit.top();
         to_visit.pop();
 
-        if (was_visited.contains(cur)) {
-            // possible depending on the number of candidate nodes in flight
-            // to be looked at. candidate set is supposed to be a *set*
+        if (was_visited[cur_idx]) {
+            // a state is pushed again each time its distance improves, the
+            // older entries are stale
             continue;
         }
+        was_visited[cur_idx] = true;
+
+        const node cur = states.at(cur_idx);
 
         auto cx    = cur.col;
         auto cy    = cur.row;
@@ -301,54 +187,125 @@ int main(int argc, char **argv)
                 continue; // stay on the board
             }
 
+            if (new_dir != ldir && steps && steps < min_run) {
+                continue; // not allowed to turn yet
+            }
+
             int new_steps = (ldir == new_dir) ? steps + 1 : 1;
 
-            if (new_steps > 3) {
+            if (new_steps > states.max_steps()) {
                 continue; // no lengthy straight-line distances
             }
 
             node candidate { static_cast<pos_t>(ny), static_cast<pos_t>(nx), new_steps, new_dir };
-            if (!was_visited.contains(candidate)) {
-                to_visit.push(candidate);
-                int new_dist = distances[cur] + (g.at(nx, ny) - '0');
-
-                if (!distances.contains(candidate) || distances[candidate] > new_dist) {
-                    distances[candidate] = new_dist;
-                    predecessors[candidate] = cur;
+            const state_id cand_idx = states.index(candidate);
+            if (!was_visited[cand_idx]) {
+                int new_dist = cur_dist + (g.at(nx, ny) - '0');
+
+                if (distances[cand_idx] > new_dist) {
+                    distances[cand_idx] = new_dist;
+                    predecessors[cand_idx] = cur_idx;
+                    to_visit.emplace(new_dist, cand_idx);
                 }
             }
         }
-
-        was_visited[cur] = true;
     }
 
     cout << "Done, looking now...\n";
 
-    vector<typename std::unordered_map<node, int>::value_type> results;
-    std::copy_if(distances.begin(), distances.end(), std::back_inserter(results),
-            [W, H](const auto &p) { return p.first.row == (H - 1) && p.first.col == (W - 1); });
-    cout << "Found " << results.size() << " possible results\n";
-
-    int min_dist = std::numeric_limits<int>::max();
-    node min_node;
-    for (const auto &r : as_const(results)) {
-        if (r.second < min_dist) {
-            min_dist = r.second;
-            min_node = r.first;
+    // every way of arriving at the bottom right cell
+    int min_dist = inf;
+    state_id min_idx = decltype(states)::none;
+    std::size_t num_results = 0;
+    for (int d = 0; d < 4; d++) {
+        for (int steps = min_run; steps <= states.max_steps(); steps++) {
+            const node end { pos_t(H - 1), pos_t(W - 1), steps, static_cast<Dir>(d) };
+            const state_id i = states.index(end);
+            if (distances[i] == inf) {
+                continue;
+            }
+            num_results++;
+            if (distances[i] < min_dist) {
+                min_dist = distances[i];
+                min_idx = i;
+            }
         }
     }
+    cout << "Found " << num_results << " possible results\n";
 
     cout << "Minimum distance of those results was " << min_dist << "\n";
 
     if constexpr (g_show_final) {
         int sum = 0;
-        while(predecessors.contains(min_node)) {
+        while(min_idx != decltype(states)::none && predecessors[min_idx] != decltype(states)::none) {
+            const node min_node = states.at(min_idx);
             int d = (g.at(min_node.col, min_node.row) - '0');
             sum += d;
-            cout << "to: [" << min_node << "] from: [" << predecessors[min_node] << "] " << d << " -> " << sum << "\n";
-            min_node = predecessors[min_node];
+            cout << "to: [" << min_node << "] from: [" << states.at(predecessors[min_idx]) << "] " << d << " -> " << sum << "\n";
+            min_idx = predecessors[min_idx];
         }
     }
+}
+
+int main(int argc, char **argv)
+{
+    using std::cerr;
+    using std::cout;
+    using std::endl;
+    using std::ifstream;
+    using std::string;
+
+    if (argc < 2) {
+        std::cerr << "Enter a file to read, optionally followed by the min and max straight run\n";
+        return 1;
+    }
+
+    run_rules rules = g_part1_rules;
+    if (argc >= 4) {
+        rules = { std::stoi(argv[2]), std::stoi(argv[3]) };
+        if (rules.min_run < 1 || rules.max_run < rules.min_run) {
+            std::cerr << "Need 1 <= min run <= max run\n";
+            return 1;
+        }
+    }
+
+    ifstream input;
+    input.exceptions(ifstream::badbit);
+
+    grid<std::uint16_t> g;
+
+    try {
+        input.open(argv[1]);
+        string line;
+        while (!input.eof() && std::getline(input, line)) {
+            g.add_line(line);
+        }
+
+        input.close();
+    }
+    catch (ifstream::failure &e) {
+        cerr << "Exception on reading input: " << e.what() << endl;
+        return 1;
+    }
+    catch (...) {
+        cerr << "Something else went wrong..." << endl;
+        return 1;
+    }
+
+    if constexpr (g_show_input) {
+        g.dump_grid();
+        cout << "\n";
+    }
+
+    // the puzzle's rule sets get a specialized search, anything else the
+    // runtime one
+    if (rules == g_part1_rules) {
+        solve<g_part1_rules.min_run, g_part1_rules.max_run>(g, rules);
+    } else if (rules == g_part2_rules) {
+        solve<g_part2_rules.min_run, g_part2_rules.max_run>(g, rules);
+    } else {
+        solve<0, 0>(g, rules);
+    }
 
     return 0;
 }
@@ -3,11 +3,14 @@
 // Grid stuff
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <barrier>
 #include <chrono>
 #include <concepts>
 #include <cstdint>
 #include <cstdlib>
-#include <fstream>
+#include <stdexcept>
 #include <functional>
 #include <iomanip>
 #include <iostream>
@@ -15,19 +18,27 @@
 #include <limits>
 #include <numeric>
 #include <queue>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <unistd.h>
 
+#include "alloc_count.h"
+#include "grid.h"
+#include "mapped_grid.h"
+
 // config
 
 static const bool g_show_input = false;
 static const bool g_show_final = false;
+static const bool g_use_fixed_grids = true; // compile-time dims for known sizes
 
 // common types
 
@@ -37,7 +48,6 @@ using std::tuple;
 using std::unordered_map;
 using std::vector;
 
-enum class Dir { west, east, north, south };
 using pos_t = uint16_t;
 
 struct node
@@ -55,126 +65,11 @@ struct node
     bool operator==(const node& o) const = default;
 };
 
-template<>
-struct std::hash<node>
-{
-    std::size_t operator()(const node& n) const noexcept
-    {
-        std::size_t h1 = std::hash<pos_t>{}(n.row);
-        std::size_t h2 = std::hash<pos_t>{}(n.col);
-
-        return h1 ^ (h2 << 1) ^ (n.horiz << 2);
-    }
-};
-
-// coordinate system:
-// leftmost character is 0, increases by 1 each character going to the right
-// topmost character is 0, increases by 1 each additional line down
-template <std::integral T>
-struct grid
-{
-    using container_t = vector<char>;
-    using pos_t       = T;
-    using bounds_t    = std::tuple<pos_t, pos_t, int>; // start, end, step
-
-    void add_line(const std::string &line);
-
-    bounds_t steps_for_dir(const pos_t pos, const Dir dir) const;
-    container_t extract_line(const pos_t pos, const Dir dir) const;
-    void set_line(const container_t &line, const pos_t pos, const Dir dir);
-    char at(const pos_t col, const pos_t row) const;
-
-    pos_t height() const { return m_height; }
-    pos_t width() const { return m_width; }
-    std::string_view view() const { return std::string_view(m_grid.data(), m_width * m_height); }
-
-    void dump_grid() const;
-
-    public:
-    container_t m_grid;
-    pos_t m_width = 0, m_height = 0;
-};
-
-//{{{
-template <std::integral T>
-void grid<T>::add_line(const std::string &line)
-{
-    if(!m_width) { m_width = line.size(); }
-    std::copy(line.begin(), line.end(), std::back_inserter(m_grid));
-    m_height++;
-}
-
-template <std::integral T>
-void grid<T>::dump_grid() const
-{
-    using std::cout;
-    cout << "grid: " << m_width << "x" << m_height << "\n";
-    for(pos_t row = 0; row < m_height; row++) {
-        const auto it = &m_grid[row * m_width];
-        std::copy(it, it + m_width, std::ostream_iterator<char>(cout));
-        cout << "\n";
-    }
-}
-
-// common code for iterating across a column or row
-template <std::integral T>
-auto grid<T>::steps_for_dir(const pos_t pos, const Dir dir) const
--> bounds_t
-{
-    pos_t start = 0, end = 0;
-    int stride = 1; // can be negative
-
-    // we will iterate up to AND INCLUDING the end
-    if (dir == Dir::east || dir == Dir::west) {
-        start = pos * m_width;
-        end = (pos + 1) * m_width - 1;
-    } else {
-        start = pos;
-        end = pos + m_width * (m_height - 1);
-        stride = m_width;
-    }
-
-    if (dir == Dir::north || dir == Dir::west) {
-        stride *= -1;
-        std::swap(start, end);
-    }
-
-    end += stride; // so we can abort as soon as we see this
-
-    return std::make_tuple(start, end, stride);
-}
-
-template <std::integral T>
-auto grid<T>::extract_line(const pos_t pos, const Dir dir) const
--> container_t
-{
-    container_t result;
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    for (pos_t i = start; i != end; i += stride) {
-        result.push_back(m_grid[i]);
-    }
-
-    return result;
-}
-
-template <std::integral T>
-void grid<T>::set_line(const container_t &line, const pos_t pos, const Dir dir)
-{
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    auto it = line.begin();
-    for (pos_t i = start; i != end; i += stride) {
-        m_grid[i] = *it++;
-    }
-}
-
-template <std::integral T>
-char grid<T>::at(const pos_t col, const pos_t row) const
-{
-    return m_grid[row * m_width + col];
-}
-//}}}
+// Nodes packed into a 32-bit id, (row * W + col) * 2 + horiz, with the end
+// node after all the others (see pathfinder::idx_from_node). Queues, the
+// visited set and predecessors all work on ids.
+using state_id = uint32_t;
+static constexpr state_id no_state = std::numeric_limits<state_id>::max();
 
 static const char *dir_name(Dir d)
 {
@@ -206,18 +101,11 @@ std::ostream& operator <<(std::ostream &os, const node &n)
     return os;
 }
 
-auto make_grid(std::ifstream &input) -> grid<uint16_t>
+auto make_grid(const char *filename) -> mapped_grid<uint16_t>
 {
-    std::string line;
-    grid<uint16_t> g;
+    mapped_grid<uint16_t> g(filename);
 
-    while (!input.eof() && std::getline(input, line)) {
-        g.add_line(line);
-    }
-
-    input.close();
-
-    if constexpr (g_show_input) {
+    if (g_show_input && g.is_open()) {
         g.dump_grid();
         std::cout << "\n";
     }
@@ -225,47 +113,141 @@ auto make_grid(std::ifstream &input) -> grid<uint16_t>
     return g;
 }
 
+// Known puzzle input sizes that get a grid specialized at compile time. The
+// sample is in here too so that the specialized path gets exercised by 'make
+// test'.
+static constexpr std::array g_fixed_sizes {
+    grid_size { 141, 141 },  // puzzle input
+    grid_size {  13,  13 },  // sample
+};
+
+// Queues of nodes to visit, each entry holds the node's priority when it was
+// pushed (its distance, plus the heuristic for A*). An entry can go stale if
+// the node is pushed again with a shorter distance, find_min_path skips those
+// when they are popped.
+enum class queue_kind { binary_heap, buckets };
+
+// Lower bound on the distance left to the goal used for A*. none is plain
+// Dijkstra.
+enum class heuristic_kind { none, manhattan, reverse_dist };
+
+struct heap_queue
+{
+    using entry = pair<int, state_id>; // 8 bytes
+
+    explicit heap_queue(int /* max_step */) { }
+
+    void push(int d, const state_id n) { m_heap.push({ d, n }); }
+    entry pop() { entry e = m_heap.top(); m_heap.pop(); return e; }
+    bool empty() const { return m_heap.empty(); }
+    std::size_t size() const { return m_heap.size(); }
+
+    private:
+    struct greater_dist {
+        bool operator()(const entry &l, const entry &r) const { return l.first > r.first; }
+    };
+    std::priority_queue<entry, vector<entry>, greater_dist> m_heap;
+};
+
+// Dial's algorithm: a push never raises the priority by more than max_step
+// over the last one popped, so all queued priorities fall in [p, p + max_step].
+// A ring of max_step + 1 buckets indexed by priority then works as the queue.
+struct bucket_queue
+{
+    using entry = pair<int, state_id>;
+
+    explicit bucket_queue(int max_step) : m_buckets(max_step + 1) { }
+
+    void push(int d, const state_id n) {
+        m_buckets[d % m_buckets.size()].push_back(n);
+        m_size++;
+    }
+    entry pop() {
+        while (m_buckets[m_cur % m_buckets.size()].empty()) {
+            m_cur++;
+        }
+        auto &b = m_buckets[m_cur % m_buckets.size()];
+        const state_id n = b.back();
+        b.pop_back();
+        m_size--;
+        return { m_cur, n };
+    }
+    bool empty() const { return !m_size; }
+    std::size_t size() const { return m_size; }
+
+    private:
+    vector<vector<state_id>> m_buckets;
+    std::size_t m_size = 0;
+    int m_cur = 0; // priority of the bucket being drained
+};
+
+// Shortest and longest straight run a crucible can make before turning.
+struct run_rules
+{
+    int min_run, max_run;
+
+    bool operator==(const run_rules &) const = default;
+};
+
+static constexpr run_rules g_part1_rules { 1, 3 };
+static constexpr run_rules g_part2_rules { 4, 10 };
+
+// MinRun/MaxRun of 0 means the rules are only known at runtime, otherwise the
+// run loops in for_each_move get compile-time trip counts.
+template <class Grid, int MinRun = 0, int MaxRun = 0>
 struct pathfinder
 {
-    pathfinder(const grid<uint16_t> &g, bool use_part1_rules)
+    pathfinder(const Grid &g, run_rules rules)
         : m_g(g)
         , W(g.width())
         , H(g.height())
-        , max_steps(use_part1_rules ? 3 : 10)
-        , part1_rules(use_part1_rules)
+        , rules(rules)
     {
-        // the +1 is for the end node
-        distances.assign(W * H * 2 + 1, std::numeric_limits<int>::max());
+        // the +1 is for the end node, main checks the ids fit state_id
+        distances.assign(std::size_t(W) * H * 2 + 1, std::numeric_limits<int>::max());
+        was_visited.assign(distances.size(), false);
+        predecessors.assign(distances.size(), no_state);
+
+        for (const Dir d : { Dir::west, Dir::east, Dir::north, Dir::south }) {
+            dir_delta[(int) d] = steps::index_delta(g, steps::of(d));
+        }
     }
 
+    template <class Queue>
     void find_min_path(const node start);
 
-    // support routines
-    vector<Dir> neighbor_dirs_for_node(const node n) const {
-        static const std::array horiz_dir = { Dir::east , Dir::west  };
-        static const std::array  vert_dir = { Dir::south, Dir::north };
-
-        vector<Dir> dirs;
+    // calls fn(candidate, cost) for each node one straight run away from n
+    template <class Fn>
+    void for_each_move(const node n, Fn &&fn) const;
 
-        if (n.horiz || is_start(n)) {
-            std::copy(horiz_dir.begin(), horiz_dir.end(), back_inserter(dirs));
-        }
+    int min_run() const {
+        if constexpr (MaxRun != 0) { return MinRun; }
+        return rules.min_run;
+    }
+    int max_run() const {
+        if constexpr (MaxRun != 0) { return MaxRun; }
+        return rules.max_run;
+    }
 
-        if (!n.horiz || is_start(n)) {
-            std::copy(vert_dir.begin(), vert_dir.end(), back_inserter(dirs));
-        }
+    // most a single move can cost: max_run cells of cost 9
+    int max_edge_cost() const { return max_run() * 9; }
 
-        return dirs;
+    // fills in lower_bounds for A*
+    void build_heuristic(heuristic_kind kind);
+    int heuristic(const node n) const {
+        if (n.type == node::end || lower_bounds.empty()) { return 0; }
+        return lower_bounds[n.row * W + n.col];
     }
 
-    std::pair<int, int> offset_for_dir(Dir dir) const {
-        static const std::array x_off = { -1, 1, 0, 0 };
-        static const std::array y_off = { 0, 0, -1, 1 };
-
-        int dx = x_off[(int) dir];
-        int dy = y_off[(int) dir];
+    // support routines
+    std::span<const Dir> neighbor_dirs_for_node(const node n) const {
+        // horizontal pair then vertical pair, the start node may go either way
+        static constexpr std::array dirs = { Dir::east, Dir::west, Dir::south, Dir::north };
 
-        return {dx, dy};
+        if (is_start(n)) {
+            return dirs;
+        }
+        return std::span(dirs).subspan(n.horiz ? 0 : 2, 2);
     }
 
     bool is_start(const node &n) const { return !n.col && !n.row; };
@@ -273,27 +255,34 @@ struct pathfinder
     node end_node() const { node n{.type = node::end}; return n; };
 
     // distances
-    std::size_t idx_from_node(const node n) const {
-        if (n.type == node::end) { return distances.size() - 1; }
-        return (n.row * W * 2) + (n.col * 2) + (int) n.horiz;
+    state_id idx_from_node(const node n) const {
+        if (n.type == node::end) { return end_id(); }
+        return (state_id(n.row) * W * 2) + (n.col * 2) + (int) n.horiz;
     };
+    node node_from_idx(const state_id i) const {
+        if (i == end_id()) { return end_node(); }
+        const state_id cell = i / 2;
+        return node { pos_t(cell / W), pos_t(cell % W), bool(i % 2) };
+    }
+    state_id end_id() const { return state_id(distances.size() - 1); }
 
     int dist (const node n) const { return distances[idx_from_node(n)]; };
     void set_dist (const node n, int d) { distances[idx_from_node(n)] = d; };
 
     // input
-    const grid<uint16_t> &m_g;
+    const Grid &m_g;
 
     // problem state
     vector<int> distances;
-    unordered_map<node, bool> was_visited;
-    unordered_map<node, node> predecessors;
+    vector<int> lower_bounds; // per cell, empty unless A* is used
+    vector<bool> was_visited;        // by id
+    vector<state_id> predecessors;   // by id, or no_state
 
     // misc metadata
-    int W;
-    int H;
-    int max_steps;
-    bool part1_rules;
+    std::array<std::ptrdiff_t, 4> dir_delta; // grid index change per Dir
+    extent_t<Grid::fixed_width> W;
+    extent_t<Grid::fixed_height> H;
+    run_rules rules;
 
     // stats
     uint_fast64_t num_visits = 0, num_neighbor_passes = 0;
@@ -304,32 +293,29 @@ struct pathfinder
 // TODO add "const node goal" argument once we can figure out how to do a
 // virtual 0-distance transition from multiple possible ending nodes at lower
 // right to a single goal state
-void pathfinder::find_min_path(const node start)
+template <class Grid, int MinRun, int MaxRun>
+template <class Queue>
+void pathfinder<Grid, MinRun, MaxRun>::find_min_path(const node start)
 {
-    const auto node_distance_compare = [&](const node &l, const node &r) {
-        return dist(l) > dist(r);
-    };
-
-    std::priority_queue<
-        node, vector<node>,
-        decltype(node_distance_compare)
-        > to_visit(node_distance_compare);
+    // A consistent heuristic can add up to another max_edge_cost to a push
+    Queue to_visit(max_edge_cost() * (lower_bounds.empty() ? 1 : 2));
 
     set_dist(start, 0);
-    to_visit.push(start);
+    to_visit.push(heuristic(start), idx_from_node(start));
 
     while(!to_visit.empty()) {
-        node cur = to_visit.top();
-        to_visit.pop();
+        const auto [cur_prio, cur_id] = to_visit.pop();
 
         // if the end node pops up here, this is the shortest possible path
         // to it and we're done. This can be a shortcut if there's still a
         // lot of other nodes to visit.
 
-        if (cur == end_node()) {
+        if (cur_id == end_id()) {
             return;
         }
 
+        const node cur = node_from_idx(cur_id);
+
         // each visit needs to reach out to all possible nodes reachable in a
         // straight line from here and mark those neighbors to be visited as
         // appropriate.
@@ -337,118 +323,641 @@ void pathfinder::find_min_path(const node start)
         num_visits++;
         cumu_visits += to_visit.size();
 
-        if (was_visited.contains(cur)) {
-            // possible depending on the number of candidate nodes in flight
-            // to be looked at. candidate set is supposed to be a *set*
+        const int cur_dist = distances[cur_id];
+        if (cur_prio > cur_dist + heuristic(cur) || was_visited[cur_id]) {
+            // stale entry, the node was pushed again later with a shorter
+            // distance
             continue;
         }
 
         num_neighbor_passes++;
 
-        auto cx = cur.col, cy = cur.row;
+        const auto cx = cur.col, cy = cur.row;
 
         // Have a single (virtual) goal node that has zero cost to transition
         // to from the any node in the lower right.
         // This relies on the other checks to ensure *this* node state was valid!
         if (cx == W - 1 && cy == H - 1) {
-            node e = end_node();
-            if (!was_visited.contains(e)) {
-                if (dist(e) > dist(cur)) {
-                    set_dist(e, dist(cur));
-                    predecessors[e] = cur;
+            const state_id e = end_id();
+            if (!was_visited[e]) {
+                if (distances[e] > cur_dist) {
+                    distances[e] = cur_dist;
+                    predecessors[e] = cur_id;
 
                     num_distance_updates++;
-                }
 
-                to_visit.push(e);
-                num_neighbor_added++;
+                    to_visit.push(cur_dist, e);
+                    num_neighbor_added++;
+                }
             }
 
-            was_visited[cur] = true;
+            was_visited[cur_id] = true;
             continue;
         }
 
         // Go through all possible directions and new nodes
-        for (const auto new_dir : neighbor_dirs_for_node(cur)) {
-            int new_dist = dist(cur);
-            pos_t nx = cx;
-            pos_t ny = cy;
-            auto [dx, dy] = offset_for_dir(new_dir);
-
-            for (int steps = 1; steps <= max_steps; steps++) {
-                nx += dx;
-                ny += dy;
-
-                // nx, ny are unsigned so can't be negative
-                if (nx >= W || ny >= H) {
-                    break; // stay on the board
+        for_each_move(cur, [&](const node &candidate, int cost) {
+            const int new_dist = cur_dist + cost;
+            const state_id cand_id = idx_from_node(candidate);
+
+            if (!was_visited[cand_id]) {
+                if (distances[cand_id] > new_dist) {
+                    distances[cand_id] = new_dist;
+                    predecessors[cand_id] = cur_id;
+
+                    num_distance_updates++;
+
+                    to_visit.push(new_dist + heuristic(candidate), cand_id);
+                    num_neighbor_added++;
                 }
+            }
+        });
+
+        was_visited[cur_id] = true;
+    }
+}
+
+template <class Grid, int MinRun, int MaxRun>
+template <class Fn>
+void pathfinder<Grid, MinRun, MaxRun>::for_each_move(const node n, Fn &&fn) const
+{
+    for (const auto new_dir : neighbor_dirs_for_node(n)) {
+        const bool vert = (new_dir == Dir::north || new_dir == Dir::south);
+        auto [dx, dy] = steps::of(new_dir);
+        const char *cell = m_g.data() + m_g.idx(n.col, n.row);
+        const std::ptrdiff_t delta = dir_delta[(int) new_dir];
+
+        // cells left before the edge of the board in this direction
+        int room;
+        switch (new_dir) {
+            case Dir::west:  room = n.col; break;
+            case Dir::east:  room = W - 1 - n.col; break;
+            case Dir::north: room = n.row; break;
+            default:         room = H - 1 - n.row; break;
+        }
+        const int last = std::min(max_run(), room);
+
+        // the first min_run - 1 cells only add cost, the crucible can't stop
+        // there
+        int cost = 0;
+        int steps = 1;
+        for (; steps < min_run() && steps <= last; steps++) {
+            cell += delta;
+            cost += (*cell - '0');
+        }
 
-                new_dist += (m_g.at(nx, ny) - '0');
+        for (; steps <= last; steps++) {
+            cell += delta;
+            cost += (*cell - '0');
+            fn(node { pos_t(n.row + dy * steps), pos_t(n.col + dx * steps), vert }, cost);
+        }
+    }
+}
+
+template <class Grid, int MinRun, int MaxRun>
+void pathfinder<Grid, MinRun, MaxRun>::build_heuristic(heuristic_kind kind)
+{
+    lower_bounds.clear();
+
+    if (kind == heuristic_kind::manhattan) {
+        // every cell still to be entered costs at least the cheapest cell
+        const int min_cost = [this] {
+            for (char c = '1'; c <= '9'; c++) {
+                if (m_g.count(c)) { return c - '0'; }
+            }
+            return 0;
+        }();
+
+        lower_bounds.resize(W * H);
+        for (int row = 0; row < H; row++) {
+            for (int col = 0; col < W; col++) {
+                lower_bounds[row * W + col] = ((W - 1 - col) + (H - 1 - row)) * min_cost;
+            }
+        }
+    } else if (kind == heuristic_kind::reverse_dist) {
+        // cheapest way to the goal from each cell if any move at all were
+        // allowed, by Dijkstra outwards from the goal
+        using entry = pair<int, int>; // distance, cell index
+        std::priority_queue<entry, vector<entry>, std::greater<entry>> q;
+        const int goal = (H - 1) * W + (W - 1);
+
+        lower_bounds.assign(W * H, std::numeric_limits<int>::max());
+        lower_bounds[goal] = 0;
+        q.push({ 0, goal });
+
+        while (!q.empty()) {
+            const auto [d, i] = q.top();
+            q.pop();
+            if (d > lower_bounds[i]) {
+                continue;
+            }
 
-                if (!part1_rules && steps < 4 && steps) {
-                    continue; // can't turn until 4 consecutive steps
+            // stepping from a neighbor into cell i costs cell i
+            const int row = i / W, col = i % W;
+            const int cost = m_g.at(col, row) - '0';
+            const std::array<pair<int, int>, 4> nbrs = {{
+                { row, col - 1 }, { row, col + 1 }, { row - 1, col }, { row + 1, col }
+            }};
+
+            for (const auto &[r, c] : nbrs) {
+                if (r < 0 || c < 0 || r >= H || c >= W) {
+                    continue;
+                }
+                const int j = r * W + c;
+                if (d + cost < lower_bounds[j]) {
+                    lower_bounds[j] = d + cost;
+                    q.push({ d + cost, j });
                 }
+            }
+        }
+    }
+}
 
-                node candidate { ny, nx, (new_dir == Dir::north || new_dir == Dir::south) };
+// Parallel delta-stepping over the same (row, col, horiz) states as
+// pathfinder. Nodes are bucketed by distance / delta; each round every thread
+// relaxes the moves out of its share of the lowest non-empty bucket, lowering
+// distances with a CAS, and the improved nodes are bucketed after a barrier.
+// Rounds repeat until that bucket stays empty, then move to the next one. The
+// search stops once no bucket left can beat the best distance to the goal.
+template <class Pathfinder>
+class delta_stepper
+{
+    public:
+    delta_stepper(Pathfinder &p, int delta, unsigned num_threads)
+        : m_p(p)
+        , m_delta(delta)
+        , m_num_threads(num_threads)
+        , m_dist(p.distances.size() - 1)
+        , m_buckets(p.max_edge_cost() / delta + 2)
+        , m_pushed(num_threads)
+        , m_expanded(num_threads)
+        , m_sync(num_threads)
+    {
+        for (auto &d : m_dist) {
+            d.store(std::numeric_limits<int>::max(), std::memory_order_relaxed);
+        }
+        for (unsigned t = 1; t < m_num_threads; t++) {
+            m_workers.emplace_back([this, t] { worker(t); });
+        }
+    }
 
-                if (!was_visited.contains(candidate)) {
-                    if (dist(candidate) > new_dist) {
-                        set_dist(candidate, new_dist);
-                        predecessors[candidate] = cur;
+    ~delta_stepper()
+    {
+        m_stop = true;
+        m_sync.arrive_and_wait(); // workers see m_stop and exit, then get joined
+    }
 
-                        num_distance_updates++;
-                    }
+    delta_stepper(const delta_stepper &) = delete;
+    delta_stepper &operator=(const delta_stepper &) = delete;
 
-                    to_visit.push(candidate);
-                    num_neighbor_added++;
+    // fills in the pathfinder's distances, including the end node's
+    void find_min_path(const node start);
+
+    private:
+    using entry = pair<int, uint32_t>; // distance when pushed, state index
+
+    // lowers m_dist[i] to d, true if it was higher
+    bool relax(uint32_t i, int d) {
+        int old = m_dist[i].load(std::memory_order_relaxed);
+        while (d < old) {
+            if (m_dist[i].compare_exchange_weak(old, d, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void push(const entry &e) {
+        m_buckets[(e.first / m_delta) % m_buckets.size()].push_back(e);
+        m_queued++;
+    }
+
+    // relax the moves out of thread t's block of m_frontier
+    void expand(unsigned t) {
+        const std::size_t n = m_frontier.size();
+        auto &out = m_pushed[t];
+        uint_fast64_t expanded = 0;
+
+        for (std::size_t k = n * t / m_num_threads; k < n * (t + 1) / m_num_threads; k++) {
+            const auto [d, i] = m_frontier[k];
+            if (d > m_dist[i].load(std::memory_order_relaxed)) {
+                continue; // stale
+            }
+
+            expanded++;
+            m_p.for_each_move(m_p.node_from_idx(i), [&](const node &candidate, int cost) {
+                const uint32_t j = m_p.idx_from_node(candidate);
+                if (relax(j, d + cost)) {
+                    out.push_back({ d + cost, j });
                 }
+            });
+        }
+
+        m_expanded[t] += expanded;
+    }
+
+    void worker(unsigned t) {
+        while (true) {
+            m_sync.arrive_and_wait(); // wait for a round to start
+            if (m_stop) {
+                return;
             }
+            expand(t);
+            m_sync.arrive_and_wait();
         }
+    }
 
-        was_visited[cur] = true;
+    Pathfinder &m_p;
+    const int m_delta;
+    const unsigned m_num_threads;
+
+    vector<std::atomic<int>> m_dist;
+    vector<vector<entry>> m_buckets; // ring, indexed by distance / delta
+    std::size_t m_queued = 0;
+    vector<entry> m_frontier;         // bucket being processed this round
+    vector<vector<entry>> m_pushed;   // per thread, merged into buckets after a round
+    vector<uint_fast64_t> m_expanded; // per thread
+
+    std::barrier<> m_sync;
+    bool m_stop = false;
+    std::vector<std::jthread> m_workers; // last, so that they're joined first
+};
+
+template <class Pathfinder>
+void delta_stepper<Pathfinder>::find_min_path(const node start)
+{
+    const uint32_t goal_h = m_p.idx_from_node(node { pos_t(m_p.H - 1), pos_t(m_p.W - 1), true });
+    const uint32_t goal_v = m_p.idx_from_node(node { pos_t(m_p.H - 1), pos_t(m_p.W - 1), false });
+
+    m_dist[m_p.idx_from_node(start)] = 0;
+    push({ 0, m_p.idx_from_node(start) });
+
+    for (int b = 0; m_queued; b++) {
+        // everything still queued is at least b * delta away
+        const int best = std::min(m_dist[goal_h].load(), m_dist[goal_v].load());
+        if (best <= b * m_delta) {
+            break;
+        }
+
+        auto &bucket = m_buckets[b % m_buckets.size()];
+        while (!bucket.empty()) {
+            m_queued -= bucket.size();
+            m_frontier.swap(bucket);
+            bucket.clear();
+
+            m_sync.arrive_and_wait(); // start the round
+            expand(0);
+            m_sync.arrive_and_wait(); // and wait for it to finish
+
+            m_p.num_visits += m_frontier.size();
+            for (auto &out : m_pushed) {
+                m_p.num_neighbor_added += out.size();
+                m_p.num_distance_updates += out.size();
+                for (const auto &e : out) {
+                    push(e);
+                }
+                out.clear();
+            }
+            m_frontier.clear();
+        }
+    }
+
+    for (std::size_t i = 0; i < m_dist.size(); i++) {
+        m_p.distances[i] = m_dist[i].load();
+    }
+    m_p.set_dist(m_p.end_node(), std::min(m_p.distances[goal_h], m_p.distances[goal_v]));
+    for (const auto e : m_expanded) {
+        m_p.num_neighbor_passes += e;
     }
 }
 
-int main(int argc, char **argv)
+// Out-of-core search for grids too big for the in-memory state arrays (or for
+// pos_t). The distance field lives in a scratch file split into square tiles
+// of cells, with at most g_resident_tiles of them mapped at once. The frontier
+// is a ring of distance buckets like bucket_queue; each bucket is sorted by
+// tile before it is expanded so that the search works through one tile at a
+// time. The input itself is only mapped, huge inputs get paged in as needed.
+static const uint32_t g_tile_dim = 256;        // cells per tile side
+static const std::size_t g_resident_tiles = 64; // 512 KiB each
+
+class tile_store
 {
-    using namespace std::chrono;
-    using std::cout;
+    public:
+    // scratch file goes in dir and is unlinked straight away
+    tile_store(const std::string &dir, uint32_t W, uint32_t H);
+    ~tile_store();
 
-    bool part1_rules = false;
-    int opt;
-    while ((opt = getopt(argc, argv, "1h")) != -1) {
-        switch(opt) {
-            case 'h': cout << "-1 to use part 1 rules. input filename required.\n";
-                return 0;
-            case '1': part1_rules = true;
-                break;
-            default:
-                std::cerr << "error detected. input filename required.\n";
-                return 1;
+    tile_store(const tile_store &) = delete;
+    tile_store &operator=(const tile_store &) = delete;
+
+    bool is_open() const { return m_fd >= 0; }
+
+    // stored as distance + 1 so that the sparse file reads back as all
+    // unreached (0) without having to be initialized
+    int get(uint32_t row, uint32_t col, bool horiz) {
+        const int32_t v = cell(row, col, horiz);
+        return v ? v - 1 : std::numeric_limits<int>::max();
+    }
+    void set(uint32_t row, uint32_t col, bool horiz, int d) { cell(row, col, horiz) = d + 1; }
+
+    uint32_t tile_of(uint32_t row, uint32_t col) const {
+        return (row / g_tile_dim) * m_tiles_x + col / g_tile_dim;
+    }
+
+    // stats
+    uint_fast64_t num_maps = 0, num_evictions = 0;
+
+    private:
+    static constexpr std::size_t tile_bytes = std::size_t(g_tile_dim) * g_tile_dim * 2 * sizeof(int32_t);
+    static constexpr uint32_t unmapped = std::numeric_limits<uint32_t>::max();
+
+    struct slot
+    {
+        uint32_t tile = unmapped;
+        int32_t *data = nullptr;
+        uint_fast64_t last_used = 0;
+    };
+
+    int32_t &cell(uint32_t row, uint32_t col, bool horiz) {
+        const uint32_t t = tile_of(row, col);
+        int32_t *data = (t == m_last_tile) ? m_last_data : map_tile(t);
+        const uint32_t r = row % g_tile_dim, c = col % g_tile_dim;
+        return data[(r * g_tile_dim + c) * 2 + horiz];
+    }
+
+    int32_t *map_tile(uint32_t t);
+
+    int m_fd = -1;
+    uint32_t m_tiles_x;
+    vector<uint32_t> m_slot_of; // per tile, or unmapped
+    vector<slot> m_slots;
+    uint_fast64_t m_clock = 0;
+    uint32_t m_last_tile = unmapped;
+    int32_t *m_last_data = nullptr;
+};
+
+//{{{
+inline tile_store::tile_store(const std::string &dir, uint32_t W, uint32_t H)
+    : m_tiles_x((W + g_tile_dim - 1) / g_tile_dim)
+    , m_slot_of(std::size_t(m_tiles_x) * ((H + g_tile_dim - 1) / g_tile_dim), unmapped)
+    , m_slots(g_resident_tiles)
+{
+    std::string path = dir + "/keepwarm-tiles-XXXXXX";
+    m_fd = ::mkstemp(path.data());
+    if (m_fd < 0) {
+        return;
+    }
+    ::unlink(path.c_str());
+
+    if (::ftruncate(m_fd, off_t(m_slot_of.size() * tile_bytes)) != 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+inline tile_store::~tile_store()
+{
+    for (const auto &sl : m_slots) {
+        if (sl.data) {
+            ::munmap(sl.data, tile_bytes);
         }
     }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
 
-    if (optind >= argc) {
-        std::cerr << "Enter a file to read\n";
+inline int32_t *tile_store::map_tile(uint32_t t)
+{
+    uint32_t si = m_slot_of[t];
+
+    if (si == unmapped) {
+        // take the least recently used slot, writing its tile back
+        si = 0;
+        for (uint32_t i = 1; i < m_slots.size(); i++) {
+            if (m_slots[i].last_used < m_slots[si].last_used) {
+                si = i;
+            }
+        }
+
+        slot &victim = m_slots[si];
+        if (victim.data) {
+            ::munmap(victim.data, tile_bytes);
+            m_slot_of[victim.tile] = unmapped;
+            num_evictions++;
+        }
+
+        void *p = ::mmap(nullptr, tile_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, off_t(std::size_t(t) * tile_bytes));
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("Unable to map distance tile");
+        }
+
+        victim = { t, static_cast<int32_t *>(p), 0 };
+        m_slot_of[t] = si;
+        num_maps++;
+    }
+
+    m_slots[si].last_used = ++m_clock;
+    m_last_tile = t;
+    m_last_data = m_slots[si].data;
+    return m_last_data;
+}
+//}}}
+
+class tiled_pathfinder
+{
+    public:
+    using tiled_grid = mapped_grid<uint32_t>;
+
+    tiled_pathfinder(const tiled_grid &g, run_rules rules, tile_store &dists)
+        : m_g(g), m_dists(dists), W(g.width()), H(g.height()), rules(rules)
+    {
+    }
+
+    // distance to the bottom right cell, or INT_MAX if it can't be reached
+    int find_min_path();
+
+    // stats
+    uint_fast64_t num_visits = 0, num_neighbor_passes = 0, num_distance_updates = 0;
+
+    private:
+    // row, col, horiz packed into a queue entry
+    static uint64_t pack(uint32_t row, uint32_t col, bool horiz) {
+        return (uint64_t(row) << 33) | (uint64_t(col) << 1) | horiz;
+    }
+
+    void relax(uint32_t row, uint32_t col, bool horiz, int d);
+
+    const tiled_grid &m_g;
+    tile_store &m_dists;
+    const uint32_t W, H;
+    const run_rules rules;
+
+    vector<vector<uint64_t>> m_buckets;
+    std::size_t m_queued = 0;
+};
+
+inline void tiled_pathfinder::relax(uint32_t row, uint32_t col, bool horiz, int d)
+{
+    if (d < m_dists.get(row, col, horiz)) {
+        m_dists.set(row, col, horiz, d);
+        m_buckets[d % m_buckets.size()].push_back(pack(row, col, horiz));
+        m_queued++;
+        num_distance_updates++;
+    }
+}
+
+inline int tiled_pathfinder::find_min_path()
+{
+    m_buckets.assign(rules.max_run * 9 + 1, {});
+    relax(0, 0, false, 0);
+
+    int best = std::numeric_limits<int>::max();
+
+    for (int d = 0; m_queued && d < best; d++) {
+        auto &bucket = m_buckets[d % m_buckets.size()];
+        if (bucket.empty()) {
+            continue;
+        }
+
+        // the bucket's own distance is the smallest possible, so nothing
+        // pushed while expanding it lands back in it
+        vector<uint64_t> cur;
+        cur.swap(bucket);
+        m_queued -= cur.size();
+
+        const auto tile_key = [this](uint64_t e) {
+            return m_dists.tile_of(uint32_t(e >> 33), uint32_t(e >> 1) & 0xffffffffu);
+        };
+        std::sort(cur.begin(), cur.end(), [&](uint64_t l, uint64_t r) {
+            return std::pair(tile_key(l), l) < std::pair(tile_key(r), r);
+        });
+
+        for (const uint64_t e : cur) {
+            const uint32_t row = e >> 33, col = (e >> 1) & 0xffffffffu;
+            const bool horiz = e & 1;
+
+            num_visits++;
+            if (m_dists.get(row, col, horiz) != d) {
+                continue; // stale
+            }
+            num_neighbor_passes++;
+
+            if (row == H - 1 && col == W - 1) {
+                best = std::min(best, d);
+                continue;
+            }
+
+            // same moves as pathfinder::for_each_move
+            const bool start = !row && !col;
+            for (const Dir dir : { Dir::east, Dir::west, Dir::south, Dir::north }) {
+                const bool vert = (dir == Dir::north || dir == Dir::south);
+                if (!start && vert == horiz) {
+                    continue; // must turn
+                }
+
+                const auto [dx, dy] = steps::of(dir);
+                int64_t r = row, c = col;
+                int cost = 0;
+
+                for (int n = 1; n <= rules.max_run; n++) {
+                    r += dy;
+                    c += dx;
+                    if (r < 0 || c < 0 || r >= H || c >= W) {
+                        break; // stay on the board
+                    }
+
+                    cost += m_g.at(uint32_t(c), uint32_t(r)) - '0';
+                    if (n >= rules.min_run) {
+                        relax(uint32_t(r), uint32_t(c), vert, d + cost);
+                    }
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+struct options
+{
+    run_rules rules = g_part2_rules;
+    bool show_stats = false;
+    queue_kind queue = queue_kind::binary_heap;
+    heuristic_kind heuristic = heuristic_kind::none;
+    bool parallel = false; // delta-stepping instead of find_min_path
+    unsigned num_threads = 0; // 0 for hardware_concurrency
+    int delta = 0; // 0 for max_edge_cost() / 4
+    const char *tile_dir = nullptr; // out-of-core search with scratch files here
+};
+
+static int solve_out_of_core(const char *filename, const options &opts)
+{
+    using namespace std::chrono;
+    using std::cout;
+
+    const tiled_pathfinder::tiled_grid g(filename);
+    if (!g.is_open()) {
+        std::cerr << "Unable to open " << filename << "\n";
         return 1;
     }
 
-    std::ifstream input;
-    input.open(argv[optind]);
-    if (!input.is_open()) {
-        std::cerr << "Unable to open " << argv[optind] << "\n";
+    tile_store dists(opts.tile_dir, g.width(), g.height());
+    if (!dists.is_open()) {
+        std::cerr << "Unable to create tile file in " << opts.tile_dir << "\n";
         return 1;
     }
 
-    auto g = make_grid(input);
-    pathfinder p(g, part1_rules);
+    tiled_pathfinder p(g, opts.rules, dists);
+
+    time_point t1 = steady_clock::now();
+    const int min_dist = p.find_min_path();
+    time_point t2 = steady_clock::now();
+
+    cout << "Min. distance: " << min_dist << "\n";
+
+    if (opts.show_stats) {
+        cout << "stats: visits: " << p.num_visits;
+        cout << ", neighbor_passes (nodes expanded): " << p.num_neighbor_passes;
+        cout << ", distance_updates: " << p.num_distance_updates;
+        cout << "\n";
+        cout << "grid size: " << uint64_t(g.width()) * g.height();
+        cout << ", tiles mapped: " << dists.num_maps << ", evicted: " << dists.num_evictions;
+        cout << ", time: " << duration<double>(t2 - t1).count();
+        cout << "\n";
+    }
+
+    return 0;
+}
+
+template <class Grid, int MinRun, int MaxRun>
+static void solve(const Grid &g, const options &opts)
+{
+    using namespace std::chrono;
+    using std::cout;
+
+    pathfinder<Grid, MinRun, MaxRun> p(g, opts.rules);
 
     time_point t1 = steady_clock::now();
+    const auto allocs_before = alloc_count();
 
-    p.find_min_path(node{});
+    if (opts.parallel) {
+        const unsigned threads = opts.num_threads ? opts.num_threads : std::max(1u, std::thread::hardware_concurrency());
+        const int delta = opts.delta ? opts.delta : std::max(1, p.max_edge_cost() / 4);
+        delta_stepper(p, delta, threads).find_min_path(node{});
+    } else {
+        p.build_heuristic(opts.heuristic);
+
+        switch (opts.queue) {
+            case queue_kind::binary_heap: p.template find_min_path<heap_queue>(node{});
+                break;
+            case queue_kind::buckets: p.template find_min_path<bucket_queue>(node{});
+                break;
+        }
+    }
 
     time_point t2 = steady_clock::now();
+    const auto num_allocs = alloc_count() - allocs_before;
 
     int min_dist = p.dist(p.end_node());
 
@@ -460,9 +969,11 @@ int main(int argc, char **argv)
         std::unordered_map<uint32_t,bool> on_path;
 
         // pre-process where path landed then print it to console
-        node min_node = p.end_node();
-        while(p.predecessors.contains(min_node)) {
-            auto prev_node = p.predecessors[min_node];
+        state_id min_id = p.end_id();
+        while(p.predecessors[min_id] != no_state) {
+            node min_node = p.node_from_idx(min_id);
+            const state_id prev_id = p.predecessors[min_id];
+            auto prev_node = p.node_from_idx(prev_id);
             bool horiz = prev_node.horiz;
             if (prev_node == node{}) {
                 horiz = min_node.row == 0;
@@ -486,7 +997,7 @@ int main(int argc, char **argv)
             }
 
             on_path[(prev_node.col << 16) | prev_node.row] = true;
-            min_node = prev_node;
+            min_id = prev_id;
         }
 
         cout << "\n";
@@ -500,11 +1011,14 @@ int main(int argc, char **argv)
             }
             cout << "\e[0m\n";
         }
+        cout << "\n";
+    }
 
-        cout << "\nstats: ";
+    if (opts.show_stats) {
+        cout << "stats: ";
         cout << "visits: " << p.num_visits;
-        cout << ", avg visit queue: " << p.cumu_visits / p.num_visits;
-        cout << ", neighbor_passes: " << p.num_neighbor_passes;
+        cout << ", avg visit queue: " << p.cumu_visits / std::max<uint_fast64_t>(p.num_visits, 1);
+        cout << ", neighbor_passes (nodes expanded): " << p.num_neighbor_passes;
         cout << ", neighbor_added: " << p.num_neighbor_added;
         cout << ", distance_updates: " << p.num_distance_updates;
         cout << "\n";
@@ -512,6 +1026,102 @@ int main(int argc, char **argv)
         cout << ", avg neighbors per grid cell: " << p.num_neighbor_added / (W * H);
         cout << ", time: " << duration<double>(t2 - t1).count();
         cout << "\n";
+        cout << "heap allocations during search: " << num_allocs;
+        cout << " (" << double(num_allocs) / std::max<uint_fast64_t>(p.num_neighbor_passes, 1) << " per node expanded)";
+        cout << "\n";
+    }
+}
+
+// picks a pathfinder specialized for the puzzle's rule sets, anything else
+// gets the runtime one
+template <class Grid>
+static void solve(const Grid &g, const options &opts)
+{
+    if (opts.rules == g_part1_rules) {
+        solve<Grid, g_part1_rules.min_run, g_part1_rules.max_run>(g, opts);
+    } else if (opts.rules == g_part2_rules) {
+        solve<Grid, g_part2_rules.min_run, g_part2_rules.max_run>(g, opts);
+    } else {
+        solve<Grid, 0, 0>(g, opts);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using std::cout;
+
+    options opts;
+    int opt;
+    while ((opt = getopt(argc, argv, "1m:abrpt:d:o:sh")) != -1) {
+        switch(opt) {
+            case 'h': cout << "-1 to use part 1 rules, -m MIN,MAX for other straight run limits,\n"
+                              "-b to use a bucket queue instead of a binary heap,\n"
+                              "-a for A* with a Manhattan distance heuristic, -r for A* with a reverse\n"
+                              "shortest path heuristic, -p for parallel delta-stepping (-t threads,\n"
+                              "-d bucket width), -o DIR for an out-of-core search keeping distances in\n"
+                              "DIR, -s to show search stats. input filename required.\n";
+                return 0;
+            case 'p': opts.parallel = true;
+                break;
+            case 'o': opts.tile_dir = optarg;
+                break;
+            case 't': opts.num_threads = std::stoi(optarg);
+                break;
+            case 'd': opts.delta = std::stoi(optarg);
+                break;
+            case 'a': opts.heuristic = heuristic_kind::manhattan;
+                break;
+            case 'r': opts.heuristic = heuristic_kind::reverse_dist;
+                break;
+            case '1': opts.rules = g_part1_rules;
+                break;
+            case 'm': {
+                    const std::string_view arg(optarg);
+                    const auto comma = arg.find(',');
+                    opts.rules.min_run = std::stoi(std::string(arg.substr(0, comma)));
+                    opts.rules.max_run = (comma == arg.npos) ? 0 : std::stoi(std::string(arg.substr(comma + 1)));
+                    if (opts.rules.min_run < 1 || opts.rules.max_run < opts.rules.min_run) {
+                        std::cerr << "-m needs 1 <= MIN <= MAX\n";
+                        return 1;
+                    }
+                }
+                break;
+            case 'b': opts.queue = queue_kind::buckets;
+                break;
+            case 's': opts.show_stats = true;
+                break;
+            default:
+                std::cerr << "error detected. input filename required.\n";
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        std::cerr << "Enter a file to read\n";
+        return 1;
+    }
+
+    if (opts.tile_dir) {
+        return solve_out_of_core(argv[optind], opts);
+    }
+
+    auto g = make_grid(argv[optind]);
+    if (!g.is_open()) {
+        std::cerr << "Unable to open " << argv[optind] << "\n";
+        return 1;
+    }
+
+    // two states per cell and the end node, with no_state left over
+    if (uint64_t(g.width()) * g.height() * 2 + 1 >= no_state) {
+        std::cerr << g.width() << "x" << g.height() << " is too big for the in-memory search, try -o DIR\n";
+        return 1;
+    }
+
+    const auto run = [&opts](const auto &g) { solve(g, opts); };
+    if constexpr (g_use_fixed_grids) {
+        dispatch_grid<g_fixed_sizes>(g, run);
+    } else {
+        run(g);
     }
 
     (void) dir_name; // silence clang warning about non-use
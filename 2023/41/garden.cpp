@@ -7,7 +7,6 @@
 #include <concepts>
 #include <cstdint>
 #include <cstdlib>
-#include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
@@ -15,8 +14,10 @@
 #include <limits>
 #include <numeric>
 #include <queue>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
@@ -24,11 +25,18 @@
 
 #include <unistd.h>
 
+#include "alloc_count.h"
+#include "bit_frontier.h"
+#include "grid.h"
+#include "mapped_grid.h"
+#include "parallel_bfs.h"
+
 // config
 
 static const bool g_show_input = true;
 static const bool g_show_final = true;
 static const bool g_show_distances = false;
+static const bool g_show_stats = false;
 
 // common types
 
@@ -38,7 +46,6 @@ using std::tuple;
 using std::unordered_map;
 using std::vector;
 
-enum class Dir { west, east, north, south };
 using pos_t = uint16_t;
 
 struct node
@@ -67,115 +74,6 @@ struct std::hash<node>
     }
 };
 
-// coordinate system:
-// leftmost character is 0, increases by 1 each character going to the right
-// topmost character is 0, increases by 1 each additional line down
-template <std::integral T>
-struct grid
-{
-    using container_t = vector<char>;
-    using pos_t       = T;
-    using bounds_t    = std::tuple<pos_t, pos_t, int>; // start, end, step
-
-    void add_line(const std::string &line);
-
-    bounds_t steps_for_dir(const pos_t pos, const Dir dir) const;
-    container_t extract_line(const pos_t pos, const Dir dir) const;
-    void set_line(const container_t &line, const pos_t pos, const Dir dir);
-    char at(const pos_t col, const pos_t row) const;
-
-    pos_t height() const { return m_height; }
-    pos_t width() const { return m_width; }
-    std::string_view view() const { return std::string_view(m_grid.data(), m_width * m_height); }
-
-    void dump_grid() const;
-
-    public:
-    container_t m_grid;
-    pos_t m_width = 0, m_height = 0;
-};
-
-//{{{
-template <std::integral T>
-void grid<T>::add_line(const std::string &line)
-{
-    if(!m_width) { m_width = line.size(); }
-    std::copy(line.begin(), line.end(), std::back_inserter(m_grid));
-    m_height++;
-}
-
-template <std::integral T>
-void grid<T>::dump_grid() const
-{
-    using std::cout;
-    cout << "grid: " << m_width << "x" << m_height << "\n";
-    for(pos_t row = 0; row < m_height; row++) {
-        const auto it = &m_grid[row * m_width];
-        std::copy(it, it + m_width, std::ostream_iterator<char>(cout));
-        cout << "\n";
-    }
-}
-
-// common code for iterating across a column or row
-template <std::integral T>
-auto grid<T>::steps_for_dir(const pos_t pos, const Dir dir) const
--> bounds_t
-{
-    pos_t start = 0, end = 0;
-    int stride = 1; // can be negative
-
-    // we will iterate up to AND INCLUDING the end
-    if (dir == Dir::east || dir == Dir::west) {
-        start = pos * m_width;
-        end = (pos + 1) * m_width - 1;
-    } else {
-        start = pos;
-        end = pos + m_width * (m_height - 1);
-        stride = m_width;
-    }
-
-    if (dir == Dir::north || dir == Dir::west) {
-        stride *= -1;
-        std::swap(start, end);
-    }
-
-    end += stride; // so we can abort as soon as we see this
-
-    return std::make_tuple(start, end, stride);
-}
-
-template <std::integral T>
-auto grid<T>::extract_line(const pos_t pos, const Dir dir) const
--> container_t
-{
-    container_t result;
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    for (pos_t i = start; i != end; i += stride) {
-        result.push_back(m_grid[i]);
-    }
-
-    return result;
-}
-
-template <std::integral T>
-void grid<T>::set_line(const container_t &line, const pos_t pos, const Dir dir)
-{
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    auto it = line.begin();
-    for (pos_t i = start; i != end; i += stride) {
-        m_grid[i] = *it++;
-    }
-}
-
-template <std::integral T>
-char grid<T>::at(const pos_t col, const pos_t row) const
-{
-    return m_grid[row * m_width + col];
-}
-//}}}
-
 static const char *dir_name(Dir d)
 {
     switch(d) {
@@ -205,18 +103,11 @@ std::ostream& operator <<(std::ostream &os, const node &n)
     return os;
 }
 
-auto make_grid(std::ifstream &input) -> grid<uint16_t>
+auto make_grid(const char *filename) -> mapped_grid<uint16_t>
 {
-    std::string line;
-    grid<uint16_t> g;
+    mapped_grid<uint16_t> g(filename);
 
-    while (!input.eof() && std::getline(input, line)) {
-        g.add_line(line);
-    }
-
-    input.close();
-
-    if constexpr (g_show_input) {
+    if (g_show_input && g.is_open()) {
         g.dump_grid();
         std::cout << "\n";
     }
@@ -226,33 +117,21 @@ auto make_grid(std::ifstream &input) -> grid<uint16_t>
 
 struct pathfinder
 {
-    pathfinder(const grid<uint16_t> &g, bool use_part1_rules)
+    pathfinder(const mapped_grid<uint16_t> &g, bool use_part1_rules)
         : m_g(g)
         , W(g.width())
         , H(g.height())
         , part1_rules(use_part1_rules)
     {
         distances.assign(W * H * 2, std::numeric_limits<int>::max());
+        was_visited.assign(W * H * 2, false);
+        predecessors.assign(W * H * 2, node{});
     }
 
     void find_min_path(const node start, const int max_steps);
 
     // support routines
-    vector<std::pair<int, int>> neighbor_dirs_for_node(const node) const {
-        static const std::array checkers {
-            -2, 0,  2, 0 , 0, 2,  0, -2 ,
-            -1, 1, -1, -1, 1, 1,  1, -1,
-            0, 0  // go away and back is valid
-        };
-
-        vector<std::pair<int, int>> dirs;
-
-        for (size_t i = 0; i < checkers.size() / 2; i++) {
-            dirs.emplace_back(checkers[i * 2], checkers[i * 2 + 1]);
-        }
-
-        return dirs;
-    }
+    std::span<const steps::offset> neighbor_dirs_for_node(const node) const { return steps::two; }
 
     bool hit_rock_dirs(pos_t cx, pos_t cy, int dx, int dy) const;
     bool hit_rock(pos_t nx, pos_t ny) const;
@@ -268,14 +147,15 @@ struct pathfinder
 
     int dist (const node n) const { return distances[idx_from_node(n)]; };
     void set_dist (const node n, int d) { distances[idx_from_node(n)] = d; };
+    bool visited (const node n) const { return was_visited[idx_from_node(n)]; };
 
     // input
-    const grid<uint16_t> &m_g;
+    const mapped_grid<uint16_t> &m_g;
 
     // problem state
     vector<int> distances;
-    unordered_map<node, bool> was_visited;
-    unordered_map<node, node> predecessors;
+    vector<bool> was_visited; // by idx_from_node
+    vector<node> predecessors;
 
     // misc metadata
     int W;
@@ -332,8 +212,23 @@ void pathfinder::find_min_path(const node start, const int max_steps)
         decltype(node_distance_compare)
         > to_visit(node_distance_compare);
 
-    set_dist(start, 0);
-    to_visit.push(start);
+    if (max_steps % 2 != 0) {
+        // make one step manually and then go by two as normal. The start
+        // can't be landed on again after an odd number of steps, so it
+        // isn't part of the visit set.
+        for (const auto &[dx, dy] : steps::one) {
+            if (hit_rock(start.col + dx, start.row + dy)) {
+                continue;
+            }
+
+            node c { pos_t(start.row + dy), pos_t(start.col + dx) };
+            set_dist(c, 1);
+            to_visit.push(c);
+        }
+    } else {
+        set_dist(start, 0);
+        to_visit.push(start);
+    }
 
     while(!to_visit.empty()) {
         node cur = to_visit.top();
@@ -346,7 +241,7 @@ void pathfinder::find_min_path(const node start, const int max_steps)
         num_visits++;
         cumu_visits += to_visit.size();
 
-        if (was_visited.contains(cur)) {
+        if (visited(cur)) {
             // possible depending on the number of candidate nodes in flight
             // to be looked at. candidate set is supposed to be a *set*
             continue;
@@ -362,10 +257,10 @@ void pathfinder::find_min_path(const node start, const int max_steps)
         if constexpr (0) {
             if (cx == W - 1 && cy == H - 1) {
                 node e = end_node();
-                if (!was_visited.contains(e)) {
+                if (!visited(e)) {
                     if (dist(e) > dist(cur)) {
                         set_dist(e, dist(cur));
-                        predecessors[e] = cur;
+                        predecessors[idx_from_node(e)] = cur;
 
                         num_distance_updates++;
                     }
@@ -374,7 +269,7 @@ void pathfinder::find_min_path(const node start, const int max_steps)
                     num_neighbor_added++;
                 }
 
-                was_visited[cur] = true;
+                was_visited[idx_from_node(cur)] = true;
                 continue;
             }
         }
@@ -407,10 +302,10 @@ void pathfinder::find_min_path(const node start, const int max_steps)
             // For the morning.
             node candidate { ny, nx };
 
-            if (!was_visited.contains(candidate)) {
+            if (!visited(candidate)) {
                 if (dist(candidate) > new_dist) {
                     set_dist(candidate, new_dist);
-                    predecessors[candidate] = cur;
+                    predecessors[idx_from_node(candidate)] = cur;
 
                     num_distance_updates++;
                 }
@@ -420,8 +315,97 @@ void pathfinder::find_min_path(const node start, const int max_steps)
             }
         }
 
-        was_visited[cur] = true;
+        was_visited[idx_from_node(cur)] = true;
+    }
+}
+
+// Same count as pathfinder, from the set of cells reached after exactly
+// max_steps steps. Paths can step back and forth so that set is every cell
+// of the right parity within max_steps.
+static int run_bit_frontier(const mapped_grid<uint16_t> &g, const node start, const int max_steps)
+{
+    using namespace std::chrono;
+    using std::cout;
+
+    const auto H = g.height(), W = g.width();
+
+    time_point t1 = steady_clock::now();
+    const auto allocs_before = alloc_count();
+
+    bit_frontier f(g);
+    f.seed(start.col, start.row);
+    const auto counts = f.run(max_steps);
+
+    time_point t2 = steady_clock::now();
+    const auto num_allocs = alloc_count() - allocs_before;
+
+    if constexpr (g_show_final) {
+        cout << "\n";
+        for (pos_t j = 0; j < H; j++) {
+            for (pos_t i = 0; i < W; i++) {
+                if (f.contains(i, j)) {
+                    cout << "\e[31;42m" << g.at(i, j);
+                } else {
+                    cout << "\e[0m" << g.at(i, j);
+                }
+            }
+            cout << "\e[0m\n";
+        }
+
+        cout << "\nplots reached after each step:";
+        for (const auto n : counts) {
+            cout << " " << n;
+        }
+        cout << "\n";
+        cout << "grid size: " << W * H;
+        cout << ", time: " << duration<double>(t2 - t1).count();
+        cout << "\n";
+        if constexpr (g_show_stats) {
+            cout << "heap allocations during search: " << num_allocs << "\n";
+        }
+
+        cout << "Could reach " << counts[max_steps] << " garden plots using up to " << max_steps << " steps.\n";
+    }
+
+    return 0;
+}
+
+// For gardens too big to draw: counts the plots at each distance with
+// parallel_bfs, then adds up the ones with max_steps' parity.
+static int run_parallel(const mapped_grid<uint16_t> &g, const node start, const int max_steps, unsigned num_threads)
+{
+    using namespace std::chrono;
+    using std::cout;
+
+    if (!num_threads) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    time_point t1 = steady_clock::now();
+
+    parallel_bfs bfs(g, num_threads);
+    const auto hist = bfs.distance_histogram(start.col, start.row, max_steps);
+
+    std::size_t sum = 0;
+    for (std::size_t d = max_steps % 2; d < hist.size(); d += 2) {
+        sum += hist[d];
     }
+
+    time_point t2 = steady_clock::now();
+
+    if constexpr (g_show_final) {
+        cout << "threads: " << num_threads;
+        cout << ", levels top-down: " << bfs.num_top_down;
+        cout << ", bottom-up: " << bfs.num_bottom_up;
+        cout << "\n";
+        cout << "grid size: " << std::size_t(g.width()) * g.height();
+        cout << ", time: " << duration<double>(t2 - t1).count();
+        cout << "\n";
+
+        cout << "Could reach " << sum << " garden plots using up to " << max_steps << " steps.\n";
+    }
+
+    return 0;
 }
 
 int main(int argc, char **argv)
@@ -430,14 +414,27 @@ int main(int argc, char **argv)
     using std::cout;
 
     bool part1_rules = false;
-    int max_steps = 6;
+    bool use_bitset = false;
+    bool use_parallel = false;
+    unsigned num_threads = 0;
+    int max_steps = 0;
     int opt;
-    while ((opt = getopt(argc, argv, "1h")) != -1) {
+    while ((opt = getopt(argc, argv, "1bp:s:h")) != -1) {
         switch(opt) {
             case 'h': cout << "-1 to use part 1 rules. input filename required.\n";
+                cout << "-b to use the bit-parallel frontier search.\n";
+                cout << "-p N to use the parallel BFS with N threads (0 for one per core).\n";
+                cout << "-s N to take N steps instead of the puzzle's.\n";
                 return 0;
+            case 'p': use_parallel = true;
+                num_threads = std::stoi(optarg);
+                break;
+            case 's': max_steps = std::stoi(optarg);
+                break;
             case '1': part1_rules = true;
                 break;
+            case 'b': use_bitset = true;
+                break;
             default:
                 std::cerr << "error detected. input filename required.\n";
                 return 1;
@@ -450,51 +447,57 @@ int main(int argc, char **argv)
     }
 
     // full search for problem
-    if (std::string{"input"} == argv[optind]) {
-        max_steps = 64;
+    if (!max_steps) {
+        max_steps = (std::string{"input"} == argv[optind]) ? 64 : 6;
     }
 
-    std::ifstream input;
-    input.open(argv[optind]);
-    if (!input.is_open()) {
+    auto g = make_grid(argv[optind]);
+    if (!g.is_open()) {
         std::cerr << "Unable to open " << argv[optind] << "\n";
         return 1;
     }
 
-    auto g = make_grid(input);
     auto H = g.height(), W = g.width();
 
-    pathfinder p(g, part1_rules);
-
     // find start
-    node start{};
-    for (pos_t j = 0; j < H; j++) {
-        for (pos_t i = 0; i < W; i++) {
-            if (g.at(i, j) == 'S') {
-                start.row = j;
-                start.col = i;
-                start.type = node::start;
-            }
-        }
-    }
-
-    if (start.type != node::start) {
+    const auto start_pos = g.find('S');
+    if (!start_pos) {
         std::cout << "Couldn't find the start point!\n";
         return 1;
     }
 
+    node start{};
+    start.col = start_pos->first;
+    start.row = start_pos->second;
+    start.type = node::start;
+
+    if (use_parallel) {
+        return run_parallel(g, start, max_steps, num_threads);
+    }
+    if (use_bitset) {
+        return run_bit_frontier(g, start, max_steps);
+    }
+
+    pathfinder p(g, part1_rules);
+
     time_point t1 = steady_clock::now();
+    const auto allocs_before = alloc_count();
 
     p.find_min_path(start, max_steps);
 
     time_point t2 = steady_clock::now();
+    const auto num_allocs = alloc_count() - allocs_before;
 
     int sum = 0;
 
     if constexpr (g_show_distances) {
-        for (const auto &n : p.was_visited) {
-            const auto [node, met] = n;
-            cout << node << "visited? " << met << ", distance was " << p.dist(node) << "\n";
+        for (pos_t j = 0; j < H; j++) {
+            for (pos_t i = 0; i < W; i++) {
+                const node n{.row = j, .col = i};
+                if (p.visited(n)) {
+                    cout << n << "visited? 1, distance was " << p.dist(n) << "\n";
+                }
+            }
         }
     }
 
@@ -527,6 +530,9 @@ int main(int argc, char **argv)
         cout << ", avg neighbors per grid cell: " << p.num_neighbor_added / (W * H);
         cout << ", time: " << duration<double>(t2 - t1).count();
         cout << "\n";
+        if constexpr (g_show_stats) {
+            cout << "heap allocations during search: " << num_allocs << "\n";
+        }
 
         cout << "Could reach " << sum << " garden plots using up to " << max_steps << " steps.\n";
     }
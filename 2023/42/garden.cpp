@@ -3,33 +3,48 @@
 // Grid stuff
 
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <concepts>
 #include <cstdint>
 #include <cstdlib>
-#include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <limits>
 #include <numeric>
+#include <optional>
 #include <queue>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <unistd.h>
 
+#include "alloc_count.h"
+#include "bit_frontier.h"
+#include "grid.h"
+#include "mapped_grid.h"
+#include "parallel_bfs.h"
+
 // config
 
 static const bool g_show_input = false;
 static const bool g_show_final = true;
 static const bool g_show_stats = false;
 static const bool g_show_distances = false;
+static const bool g_use_fixed_grids = true; // compile-time dims for known sizes
+static const int g_tiling_periods = 6;       // sampled when extrapolating -i
+static const long g_tiling_sample_share = 2; // -i samples no more than N / this steps
+static const std::size_t g_tiling_max_cells = std::size_t(1) << 29; // biggest plane -i will step
+static const long g_puzzle_steps = 26501365; // -i default
 
 // common types
 
@@ -39,7 +54,6 @@ using std::tuple;
 using std::unordered_map;
 using std::vector;
 
-enum class Dir { west, east, north, south };
 using pos_t = int;
 
 struct node
@@ -69,115 +83,6 @@ struct std::hash<node>
     }
 };
 
-// coordinate system:
-// leftmost character is 0, increases by 1 each character going to the right
-// topmost character is 0, increases by 1 each additional line down
-template <std::integral T>
-struct grid
-{
-    using container_t = vector<char>;
-    using pos_t       = T;
-    using bounds_t    = std::tuple<pos_t, pos_t, int>; // start, end, step
-
-    void add_line(const std::string &line);
-
-    bounds_t steps_for_dir(const pos_t pos, const Dir dir) const;
-    container_t extract_line(const pos_t pos, const Dir dir) const;
-    void set_line(const container_t &line, const pos_t pos, const Dir dir);
-    char at(const pos_t col, const pos_t row) const;
-
-    pos_t height() const { return m_height; }
-    pos_t width() const { return m_width; }
-    std::string_view view() const { return std::string_view(m_grid.data(), m_width * m_height); }
-
-    void dump_grid() const;
-
-    public:
-    container_t m_grid;
-    pos_t m_width = 0, m_height = 0;
-};
-
-//{{{
-template <std::integral T>
-void grid<T>::add_line(const std::string &line)
-{
-    if(!m_width) { m_width = line.size(); }
-    std::copy(line.begin(), line.end(), std::back_inserter(m_grid));
-    m_height++;
-}
-
-template <std::integral T>
-void grid<T>::dump_grid() const
-{
-    using std::cout;
-    cout << "grid: " << m_width << "x" << m_height << "\n";
-    for(pos_t row = 0; row < m_height; row++) {
-        const auto it = &m_grid[row * m_width];
-        std::copy(it, it + m_width, std::ostream_iterator<char>(cout));
-        cout << "\n";
-    }
-}
-
-// common code for iterating across a column or row
-template <std::integral T>
-auto grid<T>::steps_for_dir(const pos_t pos, const Dir dir) const
--> bounds_t
-{
-    pos_t start = 0, end = 0;
-    int stride = 1; // can be negative
-
-    // we will iterate up to AND INCLUDING the end
-    if (dir == Dir::east || dir == Dir::west) {
-        start = pos * m_width;
-        end = (pos + 1) * m_width - 1;
-    } else {
-        start = pos;
-        end = pos + m_width * (m_height - 1);
-        stride = m_width;
-    }
-
-    if (dir == Dir::north || dir == Dir::west) {
-        stride *= -1;
-        std::swap(start, end);
-    }
-
-    end += stride; // so we can abort as soon as we see this
-
-    return std::make_tuple(start, end, stride);
-}
-
-template <std::integral T>
-auto grid<T>::extract_line(const pos_t pos, const Dir dir) const
--> container_t
-{
-    container_t result;
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    for (pos_t i = start; i != end; i += stride) {
-        result.push_back(m_grid[i]);
-    }
-
-    return result;
-}
-
-template <std::integral T>
-void grid<T>::set_line(const container_t &line, const pos_t pos, const Dir dir)
-{
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    auto it = line.begin();
-    for (pos_t i = start; i != end; i += stride) {
-        m_grid[i] = *it++;
-    }
-}
-
-template <std::integral T>
-char grid<T>::at(const pos_t col, const pos_t row) const
-{
-    return m_grid[row * m_width + col];
-}
-//}}}
-
 #if 0
 static std::ostream& operator <<(std::ostream &os, const node &n)
 {
@@ -198,18 +103,11 @@ static std::ostream& operator <<(std::ostream &os, const node &n)
 }
 #endif
 
-static auto make_grid(std::ifstream &input) -> grid<uint16_t>
+static auto make_grid(const char *filename) -> mapped_grid<uint16_t>
 {
-    std::string line;
-    grid<uint16_t> g;
-
-    while (!input.eof() && std::getline(input, line)) {
-        g.add_line(line);
-    }
-
-    input.close();
+    mapped_grid<uint16_t> g(filename);
 
-    if constexpr (g_show_input) {
+    if (g_show_input && g.is_open()) {
         g.dump_grid();
         std::cout << "\n";
     }
@@ -217,47 +115,35 @@ static auto make_grid(std::ifstream &input) -> grid<uint16_t>
     return g;
 }
 
+// Known puzzle input sizes that get a grid specialized at compile time. The
+// sample is in here too so that the specialized path gets exercised by 'make
+// test'.
+static constexpr std::array g_fixed_sizes {
+    grid_size { 131, 131 },  // puzzle input
+    grid_size {  11,  11 },  // sample
+};
+
+enum class engine { pathfinder, bitset, parallel };
+
+template <class Grid>
 struct pathfinder
 {
-    pathfinder(const grid<uint16_t> &g)
+    pathfinder(const Grid &g)
         : m_g(g)
         , W(g.width())
         , H(g.height())
     {
         distances.assign(W * H * 2, std::numeric_limits<int>::max());
+        was_visited.assign(W * H, false);
     }
 
     void find_min_path(const node start, const int max_steps);
     pathfinder &set_doublestep(bool do_doublestep) { m_use_doublesteps = do_doublestep; return *this; };
 
     // support routines
-    vector<std::pair<int, int>> neighbor_dirs_one_step() const {
-        static const std::array checkers {
-            -1, 0, 1, 0, 0, -1, 0, 1
-        };
+    std::span<const steps::offset> neighbor_dirs_one_step() const { return steps::one; }
 
-        vector<std::pair<int, int>> dirs;
-        for (size_t i = 0; i < checkers.size() / 2; i++) {
-            dirs.emplace_back(checkers[i * 2], checkers[i * 2 + 1]);
-        }
-
-        return dirs;
-    }
-
-    vector<std::pair<int, int>> neighbor_dirs_for_node() const {
-        static const std::array checkers {
-            -2, 0,  2, 0 , 0, 2,  0, -2 ,
-            -1, 1, -1, -1, 1, 1,  1, -1,
-            0, 0  // go away and back is valid
-        };
-
-        vector<std::pair<int, int>> dirs;
-        for (size_t i = 0; i < checkers.size() / 2; i++) {
-            dirs.emplace_back(checkers[i * 2], checkers[i * 2 + 1]);
-        }
-
-        return dirs;
-    }
+    std::span<const steps::offset> neighbor_dirs_for_node() const { return steps::two; }
 
     bool hit_rock_dirs(int dist, pos_t cx, pos_t cy, int dx, int dy);
     bool hit_rock(int dist, pos_t nx, pos_t ny);
@@ -272,18 +158,40 @@ struct pathfinder
     int dist (const node n) const { return distances[idx_from_node(n)]; };
     void set_dist (const node n, int d) { distances[idx_from_node(n)] = d; };
 
+    // visited cells
+    bool visited (const node n) const { return was_visited[idx_from_node(n)]; };
+    void set_visited (const node n) {
+        if (!was_visited[idx_from_node(n)]) {
+            was_visited[idx_from_node(n)] = true;
+            num_visited++;
+        }
+    };
+
+    // fn(n) for each visited cell, in reading order
+    template <class Fn>
+    void for_each_visited(Fn &&fn) const {
+        for (pos_t row = 0; row < H; row++) {
+            for (pos_t col = 0; col < W; col++) {
+                if (visited(node{ .row = row, .col = col })) {
+                    fn(node{ .row = row, .col = col });
+                }
+            }
+        }
+    }
+
     // input
-    const grid<uint16_t> &m_g;
+    const Grid &m_g;
 
     // problem state
     vector<int> distances;
     vector<std::pair<node, int>> off_edge;
-    unordered_map<node, bool> was_visited;
+    vector<bool> was_visited; // by idx_from_node
+    std::size_t num_visited = 0;
     bool m_use_doublesteps = true; // false in subdivision mode
 
     // misc metadata
-    int W;
-    int H;
+    extent_t<Grid::fixed_width> W;
+    extent_t<Grid::fixed_height> H;
 
     // stats
     uint_fast64_t num_visits = 0, num_neighbor_passes = 0;
@@ -291,7 +199,8 @@ struct pathfinder
     uint_fast64_t num_neighbor_added = 0, num_distance_updates = 0;
 };
 
-bool pathfinder::hit_rock_dirs(int dist, pos_t cx, pos_t cy, int dx, int dy)
+template <class Grid>
+bool pathfinder<Grid>::hit_rock_dirs(int dist, pos_t cx, pos_t cy, int dx, int dy)
 {
     if (!dx && !dy) {
         return false;
@@ -319,7 +228,8 @@ bool pathfinder::hit_rock_dirs(int dist, pos_t cx, pos_t cy, int dx, int dy)
     return true;
 }
 
-bool pathfinder::hit_rock(int dist, pos_t nx, pos_t ny)
+template <class Grid>
+bool pathfinder<Grid>::hit_rock(int dist, pos_t nx, pos_t ny)
 {
     // if we go off board, record where it would have happened
     if (nx >= W) {
@@ -338,7 +248,8 @@ bool pathfinder::hit_rock(int dist, pos_t nx, pos_t ny)
     return (nx < 0 || ny < 0 || nx >= W || ny >= H || m_g.at(nx, ny) == '#');
 }
 
-void pathfinder::find_min_path(const node start, const int max_steps)
+template <class Grid>
+void pathfinder<Grid>::find_min_path(const node start, const int max_steps)
 {
     const auto node_distance_compare = [this](const node &l, const node &r) {
         return dist(l) > dist(r);
@@ -385,7 +296,7 @@ void pathfinder::find_min_path(const node start, const int max_steps)
         num_visits++;
         cumu_visits += to_visit.size();
 
-        if (was_visited.contains(cur)) {
+        if (visited(cur)) {
             // possible depending on the number of candidate nodes in flight
             // to be looked at. candidate set is supposed to be a *set*
             continue;
@@ -403,7 +314,7 @@ void pathfinder::find_min_path(const node start, const int max_steps)
 
         if (new_dist > max_steps) {
             // if we're searching this distance there's nothing shorter left
-            was_visited[cur] = true;
+            set_visited(cur);
             continue;
         }
 
@@ -434,7 +345,7 @@ void pathfinder::find_min_path(const node start, const int max_steps)
             }
 
             node candidate { ny, nx };
-            if (!was_visited.contains(candidate)) {
+            if (!visited(candidate)) {
                 if (dist(candidate) > new_dist) {
                     set_dist(candidate, new_dist);
 
@@ -446,7 +357,7 @@ void pathfinder::find_min_path(const node start, const int max_steps)
             }
         }
 
-        was_visited[cur] = true;
+        set_visited(cur);
     }
 
     // before we return, ensure our list of out-of-bounds encounters has
@@ -467,7 +378,206 @@ void pathfinder::find_min_path(const node start, const int max_steps)
     std::swap(off_edge, temp);
 }
 
-static void draw_color_grid(const pathfinder &p, const int max_steps)
+// One BFS distance per source for up to 16 sources at once, e.g. 'S' and
+// every point a path can enter the tile at. Sources reach a cell at
+// different levels, so no order of expanding cells settles every source's
+// distance to a cell at once, and a queue of cells ends up expanding most
+// of them about once per source anyway. So each source is a lane with its
+// own bit planes, in the guarded layout bit_frontier uses, and a level is
+// one step of every lane that is still going:
+//
+//     next = (f << 1 | f >> 1 | up | down) & open & ~seen
+//
+// over the band of rows the lane can have reached, 64 cells per word. A
+// lane's distance to a cell is written once, at the level it first gets
+// there, into that lane's own field.
+template <class Grid>
+struct multi_source_bfs
+{
+    using word_t      = uint64_t;
+    using container_t = std::vector<word_t, aligned_allocator<word_t>>;
+
+    // a shortest path visits each cell at most once, and W * H fits 32 bits
+    using dist_t = uint32_t;
+
+    static constexpr std::size_t lanes = 16;
+    static constexpr dist_t unreached = std::numeric_limits<dist_t>::max();
+
+    multi_source_bfs(const Grid &g);
+
+    // source i is lane i. Sources on a rock are never reached.
+    void find_distances(std::span<const node> sources);
+
+    // The same fields with one plain BFS per source, to compare against.
+    // Returns the cells expanded over all of them.
+    uint_fast64_t find_distances_separately(std::span<const node> sources);
+
+    dist_t dist(int source, pos_t col, pos_t row) const {
+        return distances[source * std::size_t(W) * H + std::size_t(row) * W + col];
+    }
+
+    std::size_t word_idx(pos_t col, pos_t row) const {
+        return (std::size_t(row) + 1) * m_stride + col / 64;
+    }
+
+    // input
+    const Grid &m_g;
+
+    // problem state
+    vector<dist_t> distances; // a W * H field per source
+    container_t m_open;
+
+    // misc metadata
+    extent_t<Grid::fixed_width> W;
+    extent_t<Grid::fixed_height> H;
+    std::size_t m_row_words; // words holding cells in each row
+    std::size_t m_stride;    // m_row_words + the guard word
+
+    // stats
+    uint_fast64_t num_words = 0, num_levels = 0; // words stepped over all lanes
+};
+
+template <class Grid>
+multi_source_bfs<Grid>::multi_source_bfs(const Grid &g)
+    : m_g(g)
+    , W(g.width())
+    , H(g.height())
+    , m_row_words((std::size_t(W) + 63) / 64)
+    , m_stride(m_row_words + 1)
+{
+    m_open.assign((std::size_t(H) + 2) * m_stride, 0);
+
+    const word_t tail = (W % 64) ? (word_t(1) << (W % 64)) - 1 : ~word_t(0);
+    for (pos_t r = 0; r < H; r++) {
+        const std::span<word_t> row(&m_open[word_idx(0, r)], m_row_words);
+        m_g.row_mask(r, '#', row);
+        for (word_t &w : row) {
+            w = ~w;
+        }
+        row.back() &= tail;
+    }
+}
+
+template <class Grid>
+void multi_source_bfs<Grid>::find_distances(std::span<const node> sources)
+{
+    const std::size_t num_lanes = std::min(sources.size(), lanes);
+    distances.assign(num_lanes * W * H, unreached);
+
+    // lane l's planes are [l * total, (l + 1) * total) of each
+    const std::size_t total = m_open.size();
+    container_t seen(num_lanes * total, 0), cur(num_lanes * total, 0), next(num_lanes * total, 0);
+
+    // rows that can hold a lane's frontier, grows by one each way per level
+    struct band { std::size_t lo, hi; bool live; };
+    vector<band> bands(num_lanes);
+
+    std::size_t num_live = 0;
+    for (std::size_t l = 0; l < num_lanes; l++) {
+        const node &n = sources[l];
+        bands[l] = { std::size_t(n.row), std::size_t(n.row), m_g.at(n.col, n.row) != '#' };
+        if (bands[l].live) {
+            const word_t bit = word_t(1) << (n.col % 64);
+            cur[l * total + word_idx(n.col, n.row)] = bit;
+            seen[l * total + word_idx(n.col, n.row)] = bit;
+            distances[l * W * H + std::size_t(n.row) * W + n.col] = 0;
+            num_live++;
+        }
+    }
+
+    const std::ptrdiff_t S = m_stride;
+    for (dist_t level = 1; num_live; level++) {
+        num_levels++;
+
+        for (std::size_t l = 0; l < num_lanes; l++) {
+            band &b = bands[l];
+            if (!b.live) {
+                continue;
+            }
+            b.lo = b.lo ? b.lo - 1 : 0;
+            b.hi = std::min<std::size_t>(b.hi + 1, H - 1);
+            const std::size_t first = (b.lo + 1) * m_stride;
+            const std::size_t last = (b.hi + 2) * m_stride;
+            num_words += last - first;
+
+            const word_t *__restrict f = &cur[l * total];
+            const word_t *__restrict open = m_open.data();
+            word_t *__restrict s = &seen[l * total];
+            word_t *__restrict out = &next[l * total];
+
+            word_t any = 0;
+            for (std::size_t i = first; i < last; i++) {
+                const word_t horiz = (f[i] << 1) | (f[i - 1] >> 63) | (f[i] >> 1) | (f[i + 1] << 63);
+                const word_t reached = (horiz | f[i - S] | f[i + S]) & open[i] & ~s[i];
+                out[i] = reached;
+                s[i] |= reached;
+                any |= reached;
+            }
+            if (!any) {
+                b.live = false;
+                num_live--;
+                continue;
+            }
+
+            dist_t *field = &distances[l * W * H];
+            for (std::size_t i = first; i < last; i++) {
+                if (!out[i]) {
+                    continue;
+                }
+                const std::size_t base = (i / m_stride - 1) * std::size_t(W) + (i % m_stride) * 64;
+                for (word_t m = out[i]; m; m &= m - 1) {
+                    field[base + std::countr_zero(m)] = level;
+                }
+            }
+        }
+
+        // rows outside each band are zero in both, like bit_frontier
+        std::swap(cur, next);
+    }
+}
+
+template <class Grid>
+uint_fast64_t multi_source_bfs<Grid>::find_distances_separately(std::span<const node> sources)
+{
+    const std::size_t num_lanes = std::min(sources.size(), lanes);
+    distances.assign(num_lanes * W * H, unreached);
+
+    vector<uint32_t> queue;
+    uint_fast64_t visits = 0;
+
+    for (std::size_t l = 0; l < num_lanes; l++) {
+        const node &n = sources[l];
+        if (m_g.at(n.col, n.row) == '#') {
+            continue;
+        }
+        dist_t *field = &distances[l * W * H];
+        queue.clear();
+        queue.push_back(n.row * W + n.col);
+        field[queue[0]] = 0;
+
+        for (std::size_t q = 0; q < queue.size(); q++) {
+            visits++;
+            const uint32_t idx = queue[q];
+            const pos_t cx = idx % W, cy = idx / W;
+            for (const auto &[dx, dy] : steps::one) {
+                const pos_t nx = cx + dx, ny = cy + dy;
+                if (nx < 0 || ny < 0 || nx >= W || ny >= H || m_g.at(nx, ny) == '#') {
+                    continue;
+                }
+                const uint32_t nidx = ny * W + nx;
+                if (field[nidx] == unreached) {
+                    field[nidx] = field[idx] + 1;
+                    queue.push_back(nidx);
+                }
+            }
+        }
+    }
+
+    return visits;
+}
+
+template <class Grid>
+static void draw_color_grid(const pathfinder<Grid> &p, const int max_steps)
 {
     using std::cout;
 
@@ -523,12 +633,133 @@ static void draw_color_grid(const pathfinder &p, const int max_steps)
         cout << "\n";
     }
 
-    cout << "Could reach " << p.was_visited.size() << " garden plots.\n";
+    cout << "Could reach " << p.num_visited << " garden plots.\n";
     cout << "The ones highlighted are reachable using up to " << max_steps << " steps.\n";
 }
 
+// Plots reachable in exactly n steps for any n, built once per search. A
+// plot reachable in d steps is also reachable in d + 2, d + 4, ... by
+// stepping back and forth, so that is the number of plots at distance <= n
+// with n's parity: a prefix sum over the distance histogram that skips
+// every other entry.
+struct reach_index
+{
+    // within[t] is the plots with t's parity within t steps, as
+    // bit_frontier counts them. Past the end the last two alternate.
+    explicit reach_index(vector<std::size_t> within)
+        : m_within(std::move(within))
+    {
+    }
+
+    // hist[d] is the number of plots at distance d
+    static reach_index from_histogram(const vector<std::size_t> &hist) {
+        vector<std::size_t> within(hist);
+        for (std::size_t t = 2; t < within.size(); t++) {
+            within[t] += within[t - 2];
+        }
+        return reach_index(std::move(within));
+    }
+
+    // plots of the given parity within n steps
+    std::size_t within(long n, int parity) const {
+        n = std::min<long>(n, m_within.size() - 1);
+        if ((n & 1) != parity) {
+            n--;
+        }
+        return n < 0 ? 0 : m_within[n];
+    }
+
+    std::size_t plots(long n) const { return within(n, n & 1); }
+
+    vector<std::size_t> m_within;
+};
+
+template <class Grid>
+static reach_index index_distances(const pathfinder<Grid> &p, int max_steps)
+{
+    vector<std::size_t> hist(max_steps + 1, 0);
+    p.for_each_visited([&](const node n) { hist[p.dist(n)]++; });
+    return reach_index::from_histogram(hist);
+}
+
+// break up reached cells by what third of the grid they fell into
+template <class Grid, class Fn>
+static void show_trisect(const Grid &g, Fn &&reached)
+{
+    vector<int> tri_dist(9, 0);
+    pos_t third_h = g.height() / 3;
+    pos_t third_w = g.width() / 3;
+
+    for (pos_t row = 0; row < g.height(); row++) {
+        for (pos_t col = 0; col < g.width(); col++) {
+            if (!reached(col, row)) {
+                continue;
+            }
+            pos_t cy = 2, cx = 2;
+            while(row < cy * third_h)
+                cy--;
+            while(col < cx * third_w)
+                cx--;
+            tri_dist[3 * cy + cx]++;
+        }
+    }
+
+    const auto os_flags(std::cout.flags());
+
+    static const char *const dir_chars[] = {
+        "┌", "┬", "┐",
+        "├", "┼", "┤",
+        "└", "┴", "┘",
+    };
+    for (size_t j = 0; j < 3; j++) {
+        for (size_t i = 0; i < 3; i++) {
+            const auto idx = j * 3 + i;
+            std::cout << dir_chars[i == 2 ? idx - 1 : idx] << " \e[33m" << std::setw(5) << tri_dist[idx] << "\e[0m ";
+        }
+        std::cout << dir_chars[j*3+2] << "\n";
+    }
+
+    std::cout.flags(os_flags);
+
+    int sum = std::accumulate(tri_dist.begin(), tri_dist.end(), 0);
+    std::cout << "checksum: " << sum << "\n";
+}
+
+// corners are the plots reachable in more than subdivide steps, interior
+// the ones reachable in subdivide or fewer, out of those within max_steps
+template <class Grid>
+static void show_tiled_total(const Grid &g, const reach_index &idx, int max_steps, int subdivide)
+{
+    const int even_full = idx.within(max_steps, 0), odd_full = idx.within(max_steps, 1);
+    const int even_interior = idx.within(subdivide, 0), odd_interior = idx.within(subdivide, 1);
+    const int even_corners = even_full - even_interior, odd_corners = odd_full - odd_interior;
+
+    std::cout << "For even parity:\n";
+    std::cout << "\t" << even_corners << " plots reachable >" << subdivide << "\n";
+    std::cout << "\t" << even_interior << " plots reachable <=" << subdivide << "\n";
+
+    std::cout << "For odd parity:\n";
+    std::cout << "\t" << odd_corners << " plots reachable >" << subdivide << "\n";
+    std::cout << "\t" << odd_interior << " plots reachable <=" << subdivide << "\n";
+
+    const int assumed_steps = 26501365; // from problem input
+
+    // number of grids in each dir
+    const long n = (assumed_steps - g.width()/2) / g.width();
+
+    unsigned long total =  // Don't you feel so smart?? I feel so smart!!
+        ((n+1)*(n+1)) * odd_full +
+        (n*n) * even_full -
+        (n+1) * odd_corners +
+        n * even_corners; // so l33t!!!!111one
+
+    std::cout << "In theory the final answer for this particular remarkably well-behaved input\n";
+    std::cout << "is: \e[30;102m" << total << "\e[0m\n";
+}
+
+template <class Grid>
 static unsigned long count_cells_recursive(
-        const grid<uint16_t> &g,
+        const Grid &g,
         node start,
         int max_steps,
         bool trisect,
@@ -538,104 +769,583 @@ static unsigned long count_cells_recursive(
     using std::pair;
     unsigned long sum = 0;
 
-    pathfinder p(g);
+    pathfinder<Grid> p(g);
 
     p.set_doublestep(subdivide == 0)
      .find_min_path(start, max_steps);
-    sum = p.was_visited.size();
+    sum = p.num_visited;
 
     if (g.at(start.col, start.row) == 'S') {
         draw_color_grid(p, subdivide ? subdivide : max_steps);
     }
 
     if (trisect) {
-        // break up distances by what part of grid they fell into
-        vector<int> tri_dist(9, 0);
-        pos_t third_h = g.height() / 3;
-        pos_t third_w = g.width() / 3;
+        show_trisect(g, [&p](pos_t col, pos_t row) {
+                return p.visited(node{.row = row, .col = col});
+                });
+    }
 
-        for (const auto &p : p.was_visited) {
-            const node n = p.first;
-            pos_t cy = 2, cx = 2;
-            while(n.row < cy * third_h)
-                cy--;
-            while(n.col < cx * third_w)
-                cx--;
-            tri_dist[3 * cy + cx]++;
-        }
+    if (subdivide > 0) {
+        show_tiled_total(g, index_distances(p, max_steps), max_steps, subdivide);
+    }
 
-        const auto os_flags(std::cout.flags());
+    return sum;
+}
 
-        static const char *const dir_chars[] = {
-            "┌", "┬", "┐",
-            "├", "┼", "┤",
-            "└", "┴", "┘",
-        };
-        for (size_t j = 0; j < 3; j++) {
-            for (size_t i = 0; i < 3; i++) {
-                const auto idx = j * 3 + i;
-                std::cout << dir_chars[i == 2 ? idx - 1 : idx] << " \e[33m" << std::setw(5) << tri_dist[idx] << "\e[0m ";
+// Same answers as count_cells_recursive from one sweep of bit_frontier. The
+// cells reached after exactly t steps are all the cells of t's parity that
+// are within t steps, so the per-step counts give every parity split
+// directly. -t trisects the cells reached after exactly max_steps.
+template <class Grid>
+static unsigned long count_cells_bitset(
+        const Grid &g,
+        node start,
+        int max_steps,
+        bool trisect,
+        int subdivide
+        )
+{
+    bit_frontier f(g);
+    f.seed(start.col, start.row);
+    const auto counts = f.run(max_steps);
+
+    if constexpr (g_show_final) {
+        for (pos_t j = 0; j < g.height(); j++) {
+            for (pos_t i = 0; i < g.width(); i++) {
+                std::cout << (f.contains(i, j) ? "\e[30;102m" : "\e[0m") << g.at(i, j);
             }
-            std::cout << dir_chars[j*3+2] << "\n";
+            std::cout << "\e[0m\n";
         }
+        std::cout << "Could reach " << counts[max_steps] << " garden plots in exactly " << max_steps << " steps.\n";
+    }
 
-        std::cout.flags(os_flags);
+    if (trisect) {
+        show_trisect(g, [&f](pos_t col, pos_t row) { return f.contains(col, row); });
+    }
 
-        int sum = std::accumulate(tri_dist.begin(), tri_dist.end(), 0);
-        std::cout << "checksum: " << sum << "\n";
+    if (subdivide > 0) {
+        show_tiled_total(g, reach_index(counts), max_steps, subdivide);
+    }
+
+    return counts[max_steps];
+}
+
+// For gardens too big for the others: the distance histogram from
+// parallel_bfs indexed the same way. No per-cell output.
+template <class Grid>
+static unsigned long count_cells_parallel(
+        const Grid &g,
+        node start,
+        int max_steps,
+        int subdivide,
+        unsigned num_threads
+        )
+{
+    parallel_bfs bfs(g, num_threads);
+    const auto idx = reach_index::from_histogram(bfs.distance_histogram(start.col, start.row, max_steps));
+
+    if constexpr (g_show_stats) {
+        std::cout << "threads: " << num_threads
+            << ", levels top-down: " << bfs.num_top_down
+            << ", bottom-up: " << bfs.num_bottom_up << "\n";
+    }
+    if constexpr (g_show_final) {
+        std::cout << "Could reach " << idx.plots(max_steps) << " garden plots in exactly " << max_steps << " steps.\n";
     }
 
     if (subdivide > 0) {
-        // break up into visited cells that are <= the given value or those
-        // greater.
-        int even_corners = std::count_if(p.was_visited.begin(), p.was_visited.end(),
-                [&p, subdivide](const auto &val) {
-                const auto d = p.dist(val.first);
-                return (d % 2 == 0 && d > subdivide);
-                });
-        int even_interior = std::count_if(p.was_visited.begin(), p.was_visited.end(),
-                [&p, subdivide](const auto &val) {
-                const auto d = p.dist(val.first);
-                return (d % 2 == 0 && d <= subdivide);
-                });
+        show_tiled_total(g, idx, max_steps, subdivide);
+    }
+
+    return idx.plots(max_steps);
+}
 
-        std::cout << "For even parity:\n";
-        std::cout << "\t" << even_corners << " plots reachable >" << subdivide << "\n";
-        std::cout << "\t" << even_interior << " plots reachable <=" << subdivide << "\n";
+// Answers every step count and subdivision threshold from one search that
+// runs until no more plots can be reached.
+template <class Grid>
+static int answer_queries(
+        const Grid &g,
+        node start,
+        int max_steps,
+        engine eng,
+        unsigned num_threads,
+        const vector<long> &step_queries,
+        const vector<long> &split_queries
+        )
+{
+    const int horizon = std::numeric_limits<int>::max() - 2;
 
-        int odd_corners = std::count_if(p.was_visited.begin(), p.was_visited.end(),
-                [&p, subdivide](const auto &val) {
-                const auto d = p.dist(val.first);
-                return (d % 2 == 1 && d > subdivide);
-                });
-        int odd_interior = std::count_if(p.was_visited.begin(), p.was_visited.end(),
-                [&p, subdivide](const auto &val) {
-                const auto d = p.dist(val.first);
-                return (d % 2 == 1 && d <= subdivide);
-                });
+    const auto idx = [&] {
+        if (eng == engine::bitset) {
+            bit_frontier f(g);
+            f.seed(start.col, start.row);
+            return reach_index(f.run_until_settled(horizon));
+        }
+        if (eng == engine::parallel) {
+            parallel_bfs bfs(g, num_threads);
+            return reach_index::from_histogram(bfs.distance_histogram(start.col, start.row, horizon));
+        }
 
-        std::cout << "For odd parity:\n";
-        std::cout << "\t" << odd_corners << " plots reachable >" << subdivide << "\n";
-        std::cout << "\t" << odd_interior << " plots reachable <=" << subdivide << "\n";
+        pathfinder<Grid> p(g);
+        p.set_doublestep(false).find_min_path(start, horizon);
 
-        const int assumed_steps = 26501365; // from problem input
-        const int odd_full = odd_corners + odd_interior;
-        const int even_full = even_corners + even_interior;
+        int farthest = 0;
+        p.for_each_visited([&](const node n) { farthest = std::max(farthest, p.dist(n)); });
+        return index_distances(p, farthest);
+    }();
 
-        // number of grids in each dir
-        const long n = (assumed_steps - g.width()/2) / g.width();
+    for (const long n : step_queries) {
+        std::cout << n << " steps: " << idx.plots(n) << " plots\n";
+    }
+    for (const long s : split_queries) {
+        std::cout << "subdivided at " << s << ":\n";
+        show_tiled_total(g, idx, max_steps, s);
+    }
 
-        unsigned long total =  // Don't you feel so smart?? I feel so smart!!
-            ((n+1)*(n+1)) * odd_full +
-            (n*n) * even_full -
-            (n+1) * odd_corners +
-            n * even_corners; // so l33t!!!!111one
+    return 0;
+}
 
-        std::cout << "In theory the final answer for this particular remarkably well-behaved input\n";
-        std::cout << "is: \e[30;102m" << total << "\e[0m\n";
+// "6,10,64" -> { 6, 10, 64 }
+static vector<long> parse_list(const std::string &arg)
+{
+    vector<long> values;
+    std::size_t pos = 0;
+    while (pos <= arg.size()) {
+        const auto comma = std::min(arg.find(',', pos), arg.size());
+        values.push_back(std::stol(arg.substr(pos, comma - pos)));
+        pos = comma + 1;
     }
+    return values;
+}
 
-    return sum;
+// Distance fields from 'S' and from each corner and edge midpoint, the
+// points a path coming in from a neighbouring tile enters at.
+template <class Grid>
+static int show_entry_fields(const Grid &g, node start)
+{
+    using std::cout;
+    using std::setw;
+
+    const pos_t W = g.width(), H = g.height();
+    const std::array<node, 9> sources {{
+        start,
+        { 0, 0 }, { 0, W / 2 }, { 0, W - 1 },
+        { H / 2, 0 }, { H / 2, W - 1 },
+        { H - 1, 0 }, { H - 1, W / 2 }, { H - 1, W - 1 },
+    }};
+    static const char *const names[] = { "start", "nw", "n", "ne", "w", "e", "sw", "s", "se" };
+
+    using namespace std::chrono;
+
+    multi_source_bfs p(g);
+    const time_point t1 = steady_clock::now();
+    p.find_distances(sources);
+    const time_point t2 = steady_clock::now();
+
+    std::array<int, sources.size()> farthest{}, even{}, odd{};
+    for (pos_t row = 0; row < H; row++) {
+        for (pos_t col = 0; col < W; col++) {
+            for (std::size_t i = 0; i < sources.size(); i++) {
+                const auto d = p.dist(i, col, row);
+                if (d == p.unreached) {
+                    continue;
+                }
+                farthest[i] = std::max<int>(farthest[i], d);
+                (d % 2 ? odd : even)[i]++;
+            }
+        }
+    }
+
+    const auto os_flags(cout.flags());
+    cout << "source     at  farthest   even    odd\n";
+    for (std::size_t i = 0; i < sources.size(); i++) {
+        cout << std::left << setw(6) << names[i] << std::right
+            << setw(4) << sources[i].col << "," << std::left << setw(4) << sources[i].row << std::right
+            << setw(6) << farthest[i]
+            << setw(7) << even[i]
+            << setw(7) << odd[i] << "\n";
+    }
+    cout.flags(os_flags);
+
+    if constexpr (g_show_stats) {
+        cout << "stats: levels: " << p.num_levels << ", words stepped: " << p.num_words
+            << ", grid size: " << W * H << "\n";
+
+        // the fields above are done with, so they can be overwritten
+        multi_source_bfs q(g);
+        const time_point t3 = steady_clock::now();
+        const auto separate_visits = q.find_distances_separately(sources);
+        const time_point t4 = steady_clock::now();
+        cout << "stats: lanes: " << duration<double>(t2 - t1).count() << "s, "
+            << "one BFS per source: " << separate_visits << " visits, "
+            << duration<double>(t4 - t3).count() << "s\n";
+    }
+
+    return 0;
+}
+
+// The garden repeated without end, cut down to (2 * reps_x + 1) by
+// (2 * reps_y + 1) copies with the original in the middle, in the form
+// bit_frontier builds from.
+template <class Grid>
+struct tiled_plane
+{
+    tiled_plane(const Grid &g, std::size_t reps_x, std::size_t reps_y)
+        : m_g(g), m_reps_x(reps_x), m_reps_y(reps_y)
+    {
+    }
+
+    std::size_t width() const { return std::size_t(m_g.width()) * (2 * m_reps_x + 1); }
+    std::size_t height() const { return std::size_t(m_g.height()) * (2 * m_reps_y + 1); }
+
+    void row_mask(std::size_t row, char c, std::span<uint64_t> out) const {
+        const auto src = m_g.row(row % m_g.height());
+        m_line.clear();
+        for (std::size_t i = 0; i < 2 * m_reps_x + 1; i++) {
+            m_line += src;
+        }
+        scan::match_mask(m_line.data(), m_line.size(), c, out);
+    }
+
+    // where a cell of the middle copy is
+    std::size_t col(pos_t c) const { return m_reps_x * m_g.width() + c; }
+    std::size_t row(pos_t r) const { return m_reps_y * m_g.height() + r; }
+
+    const Grid &m_g;
+    std::size_t m_reps_x, m_reps_y;
+    mutable std::string m_line;
+};
+
+// Exact counts on the infinitely tiled garden for any number of steps, with
+// Gosper's HashLife. Cells are rock, open or reached, and a step is
+// bit_frontier's: an open cell is reached if a neighbour was. Blocks of
+// 2^k x 2^k cells are hash-consed quadtree nodes, so the repeating garden
+// and the regular parts of the reached area share nodes. Each node
+// memoizes its centre half advanced 2^j steps, and N steps are one such
+// jump per set bit of N. Before each jump the root is grown around the
+// start until the reached area can't get near its edge. Everything past
+// the root is untouched garden, built from the same pattern.
+//
+// Exact whatever the input, but memory follows how irregular the edge of
+// the reached area is, so it suits inputs like the puzzle's best.
+template <class Grid>
+class hashlife
+{
+    public:
+    hashlife(const Grid &g, node start)
+        : m_g(g), m_start(start)
+    {
+        // the leaves, ids match cell
+        for (const uint64_t pop : { 0, 0, 1 }) {
+            m_nodes.push_back({ {}, 0, pop });
+        }
+    }
+
+    // plots reached in exactly N steps
+    uint64_t count_after(long N);
+
+    std::size_t num_nodes() const { return m_nodes.size(); }
+
+    private:
+    using id_t = uint32_t;
+    enum cell : id_t { rock, open, reached };
+    static constexpr id_t none = std::numeric_limits<id_t>::max();
+
+    struct qnode
+    {
+        std::array<id_t, 4> c; // nw, ne, sw, se
+        int level;
+        uint64_t pop;          // reached cells
+        id_t next = none;      // advance(id, level - 2), once known
+    };
+
+    struct children_hash
+    {
+        std::size_t operator()(const std::array<id_t, 4> &c) const noexcept {
+            uint64_t h = (uint64_t(c[0]) << 32 | c[1]) * 0x9E3779B97F4A7C15ull;
+            h ^= (uint64_t(c[2]) << 32 | c[3]) + (h << 6) + (h >> 2);
+            return h * 0xBF58476D1CE4E5B9ull;
+        }
+    };
+
+    const qnode &at(id_t id) const { return m_nodes[id]; }
+
+    id_t join(id_t nw, id_t ne, id_t sw, id_t se);
+    id_t centre(id_t n);
+    id_t garden(int level, int64_t x, int64_t y);
+    id_t set_reached(id_t n, int64_t x, int64_t y);
+    id_t grow(id_t n, int64_t x, int64_t y);
+    id_t advance(id_t n, int j);
+    id_t step_4x4(id_t n);
+
+    const Grid &m_g;
+    const node m_start;
+
+    vector<qnode> m_nodes;
+    unordered_map<std::array<id_t, 4>, id_t, children_hash> m_ids;
+    unordered_map<uint64_t, id_t> m_garden;   // by level and offset in the tile
+    unordered_map<uint64_t, id_t> m_advanced; // shorter jumps, by id and log2 of the steps
+};
+
+template <class Grid>
+auto hashlife<Grid>::join(id_t nw, id_t ne, id_t sw, id_t se) -> id_t
+{
+    const std::array<id_t, 4> c { nw, ne, sw, se };
+    const auto [it, added] = m_ids.try_emplace(c, m_nodes.size());
+    if (added) {
+        m_nodes.push_back({ c, at(nw).level + 1, at(nw).pop + at(ne).pop + at(sw).pop + at(se).pop });
+    }
+    return it->second;
+}
+
+// the middle half of a node, a level down
+template <class Grid>
+auto hashlife<Grid>::centre(id_t n) -> id_t
+{
+    const auto c = at(n).c;
+    return join(at(c[0]).c[3], at(c[1]).c[2], at(c[2]).c[1], at(c[3]).c[0]);
+}
+
+// untouched garden with top left at (x, y), where the start is (0, 0)
+template <class Grid>
+auto hashlife<Grid>::garden(int level, int64_t x, int64_t y) -> id_t
+{
+    const int64_t W = m_g.width(), H = m_g.height();
+    const int64_t col = ((x + m_start.col) % W + W) % W;
+    const int64_t row = ((y + m_start.row) % H + H) % H;
+
+    if (!level) {
+        return m_g.at(col, row) == '#' ? rock : open;
+    }
+
+    const uint64_t key = uint64_t(level) << 48 | uint64_t(col) << 24 | uint64_t(row);
+    if (const auto it = m_garden.find(key); it != m_garden.end()) {
+        return it->second;
+    }
+
+    const int64_t h = int64_t(1) << (level - 1);
+    const id_t id = join(garden(level - 1, x, y), garden(level - 1, x + h, y),
+            garden(level - 1, x, y + h), garden(level - 1, x + h, y + h));
+    m_garden.emplace(key, id);
+    return id;
+}
+
+// n with the cell at (x, y) from its top left reached
+template <class Grid>
+auto hashlife<Grid>::set_reached(id_t n, int64_t x, int64_t y) -> id_t
+{
+    const int level = at(n).level;
+    if (!level) {
+        return n == rock ? rock : reached;
+    }
+
+    const int64_t h = int64_t(1) << (level - 1);
+    auto c = at(n).c;
+    const int q = (y >= h) * 2 + (x >= h);
+    c[q] = set_reached(c[q], x % h, y % h);
+    return join(c[0], c[1], c[2], c[3]);
+}
+
+// n, with its top left at (x, y), in the middle of garden twice its size
+template <class Grid>
+auto hashlife<Grid>::grow(id_t n, int64_t x, int64_t y) -> id_t
+{
+    const int level = at(n).level;
+    const int64_t h = int64_t(1) << (level - 1);
+    const auto c = at(n).c; // join() can move the nodes
+    // blocks of the grown node in a 4x4 grid, n being the middle 2x2
+    const auto g = [&](int64_t i, int64_t j) { return garden(level - 1, x + (i - 1) * h, y + (j - 1) * h); };
+
+    return join(join(g(0, 0), g(1, 0), g(0, 1), c[0]),
+                join(g(2, 0), g(3, 0), c[1], g(3, 1)),
+                join(g(0, 2), c[2], g(0, 3), g(1, 3)),
+                join(c[3], g(3, 2), g(2, 3), g(3, 3)));
+}
+
+// the centre 2x2 of a 4x4 node after one step
+template <class Grid>
+auto hashlife<Grid>::step_4x4(id_t n) -> id_t
+{
+    std::array<std::array<id_t, 4>, 4> cell;
+    for (int q = 0; q < 4; q++) {
+        const auto &sub = at(at(n).c[q]).c;
+        for (int k = 0; k < 4; k++) {
+            cell[(q / 2) * 2 + k / 2][(q % 2) * 2 + k % 2] = sub[k];
+        }
+    }
+
+    std::array<id_t, 4> out;
+    for (int k = 0; k < 4; k++) {
+        const int r = 1 + k / 2, c = 1 + k % 2;
+        const bool near = cell[r - 1][c] == reached || cell[r + 1][c] == reached
+            || cell[r][c - 1] == reached || cell[r][c + 1] == reached;
+        out[k] = cell[r][c] == rock ? rock : (near ? reached : open);
+    }
+    return join(out[0], out[1], out[2], out[3]);
+}
+
+// the centre half of n after 2^j steps, j <= level - 2
+template <class Grid>
+auto hashlife<Grid>::advance(id_t n, int j) -> id_t
+{
+    const int level = at(n).level;
+    const bool full = j == level - 2;
+    if (full && at(n).next != none) {
+        return at(n).next;
+    }
+    if (level == 2) {
+        return m_nodes[n].next = step_4x4(n);
+    }
+
+    const uint64_t key = uint64_t(n) << 6 | j;
+    if (!full) {
+        if (const auto it = m_advanced.find(key); it != m_advanced.end()) {
+            return it->second;
+        }
+    }
+
+    // the nine overlapping subnodes a level down, row by row
+    const auto [nw, ne, sw, se] = at(n).c;
+    const auto a = at(nw).c, b = at(ne).c, c = at(sw).c, d = at(se).c;
+    const std::array<id_t, 9> sub {
+        nw, join(a[1], b[0], a[3], b[2]), ne,
+        join(a[2], a[3], c[0], c[1]), join(a[3], b[2], c[1], d[0]), join(b[2], b[3], d[0], d[1]),
+        sw, join(c[1], d[0], c[3], d[2]), se,
+    };
+
+    // two half jumps, or none and then the whole one if it is shorter
+    std::array<id_t, 9> r;
+    for (int i = 0; i < 9; i++) {
+        r[i] = full ? advance(sub[i], level - 3) : centre(sub[i]);
+    }
+
+    const int jj = full ? level - 3 : j;
+    const id_t id = join(
+            advance(join(r[0], r[1], r[3], r[4]), jj),
+            advance(join(r[1], r[2], r[4], r[5]), jj),
+            advance(join(r[3], r[4], r[6], r[7]), jj),
+            advance(join(r[4], r[5], r[7], r[8]), jj));
+    if (full) {
+        m_nodes[n].next = id;
+    } else {
+        m_advanced.emplace(key, id);
+    }
+    return id;
+}
+
+template <class Grid>
+uint64_t hashlife<Grid>::count_after(long N)
+{
+    // root covers [-2^(level-1), 2^(level-1)) both ways around the start
+    int level = 3;
+    int64_t half = int64_t(1) << (level - 1);
+    id_t root = set_reached(garden(level, -half, -half), half, half);
+
+    long t = 0;
+    for (int j = 62; j >= 0; j--) {
+        if (!((N >> j) & 1)) {
+            continue;
+        }
+
+        // the jump reads up to 2^j past the reached area, and its result
+        // is the middle half of the grown root
+        while (half < t + (int64_t(1) << j) + 1 || level < j + 1) {
+            root = grow(root, -half, -half);
+            level++;
+            half *= 2;
+        }
+
+        root = advance(grow(root, -half, -half), j);
+        t += long(1) << j;
+    }
+
+    return at(root).pop;
+}
+
+// Plots reached in exactly N steps on the infinitely tiled garden.
+//
+// Once the frontier is clear of the start, moving N on by a period P of the
+// tiling adds one more ring of tiles that fill the same way, so f(r + kP) is
+// quadratic in k from some k0 on. P is lcm(W, H), or twice that if tiles
+// alternate parity. One bit_frontier sweep over enough copies gives f at
+// every step up to g_tiling_periods double periods, doubled until growth
+// settles. The second differences of f(r + kP) have to agree for at least
+// three samples through to the last one before they are used to
+// extrapolate. A sweep costs about the cube of its length, so sampling
+// stops once the next sweep would be longer than N / g_tiling_sample_share
+// and all of them together stay well under simulating N. If no period has
+// settled by then, N is simulated exactly if the plane for it fits in
+// g_tiling_max_cells.
+template <class Grid>
+static std::optional<uint64_t> count_cells_tiled(const Grid &g, node start, long N, bool exact_only)
+{
+    using std::cout;
+
+    const long W = g.width(), H = g.height();
+    const long L = std::lcm(W, H);
+
+    // f(t) for t = 0..T, if a plane big enough for T fits
+    const auto sweep = [&](long T) -> std::optional<vector<std::size_t>> {
+        const tiled_plane plane(g, T / W + 1, T / H + 1);
+        if (plane.width() * plane.height() > g_tiling_max_cells) {
+            return std::nullopt;
+        }
+        bit_frontier f(plane);
+        f.seed(plane.col(start.col), plane.row(start.row));
+        return f.run(T);
+    };
+
+    const auto extrapolate = [N](const vector<std::size_t> &counts, long P) -> std::optional<uint64_t> {
+        const long r = N % P;
+        vector<int64_t> a;
+        for (std::size_t t = r; t < counts.size(); t += P) {
+            a.push_back(counts[t]);
+        }
+        if (a.size() < 5) {
+            return std::nullopt;
+        }
+
+        const auto d2 = [&a](std::size_t k) { return a[k + 2] - 2 * a[k + 1] + a[k]; };
+        std::size_t k0 = a.size() - 3;
+        while (k0 > 0 && d2(k0 - 1) == d2(k0)) {
+            k0--;
+        }
+        if (a.size() - 2 - k0 < 3) {
+            return std::nullopt;
+        }
+
+        // carry the last difference on, growing by d2 each period
+        const std::size_t j = a.size() - 1;
+        const int64_t m = (N - r) / P - j;
+        const int64_t total = a[j] + m * (a[j] - a[j - 1]) + m * (m + 1) / 2 * d2(k0);
+
+        cout << "period " << P << ": f(" << r << " + " << P << "k) quadratic from k = " << k0
+            << ", second difference " << d2(k0) << "\n";
+        return total;
+    };
+
+    // sample more periods while that is still cheaper than simulating N
+    for (long periods = g_tiling_periods; !exact_only; periods *= 2) {
+        const long T = 2 * L * (periods + 1);
+        if (T > N / g_tiling_sample_share) {
+            break;
+        }
+        const auto counts = sweep(T);
+        if (!counts) {
+            break;
+        }
+        for (const long P : { L, 2 * L }) {
+            if (const auto total = extrapolate(*counts, P)) {
+                return total;
+            }
+        }
+        cout << "no periodic growth within " << periods << " periods of " << 2 * L << "\n";
+    }
+
+    if (const auto counts = sweep(N)) {
+        return (*counts)[N];
+    }
+    return std::nullopt;
 }
 
 int main(int argc, char **argv)
@@ -643,13 +1353,49 @@ int main(int argc, char **argv)
     using namespace std::chrono;
     using std::cout;
 
-    int max_steps = 0;
+    long max_steps = 0;
     int subdivide = 0;
     bool subdivide_flag = true; // default on so answer will generate on problem input
     bool trisect = false;
+    engine eng = engine::pathfinder;
+    unsigned num_threads = 0;
+    bool infinite = false;
+    bool exact_only = false;
+    bool quadtree = false;
+    bool entry_fields = false;
+    vector<long> step_queries, split_queries;
     int opt;
-    while ((opt = getopt(argc, argv, "nth")) != -1) {
+    while ((opt = getopt(argc, argv, "bp:eilxq:d:tnh")) != -1) {
         switch(opt) {
+            case 'q':
+                step_queries = parse_list(optarg);
+                break;
+            case 'd':
+                split_queries = parse_list(optarg);
+                break;
+            case 'e':
+                entry_fields = true;
+                break;
+            case 'i':
+                infinite = true;
+                break;
+            case 'x':
+                exact_only = true;
+                break;
+            case 'l':
+                quadtree = true;
+                break;
+            case 'b':
+                eng = engine::bitset;
+                break;
+            case 'p':
+                eng = engine::parallel;
+                if (const int n = std::stoi(optarg); n >= 0) {
+                    num_threads = n;
+                    break;
+                }
+                std::cerr << "Something went wrong with -p, it can't be negative\n";
+                return 1;
             default:
             case 'n':
                 subdivide_flag = false;
@@ -658,7 +1404,19 @@ int main(int argc, char **argv)
                 trisect = true;
                 break;
             case 'h':
-                cout << "usage: " << argv[0] << " [-n] [-t] filename [max_steps] [subdivision]\n";
+                cout << "usage: " << argv[0] << " [-b | -p N] [-e] [-i [-x | -l]] [-q N,...] [-d N,...] [-n] [-t] filename [max_steps] [subdivision]\n";
+                cout << "  -b  Use the bit-parallel frontier search instead of the pathfinder.\n";
+                cout << "      With -t it trisects the plots reached in exactly max_steps.\n";
+                cout << "  -p  Use the parallel BFS with N threads (0 for one per core). For\n";
+                cout << "      big gardens, it draws nothing and ignores -t.\n";
+                cout << "  -e  Show distance fields from 'S' and the tile corners and edge midpoints.\n";
+                cout << "  -i  Count plots on the infinitely tiled garden, extrapolating\n";
+                cout << "      from a few periods of growth. max_steps defaults to " << g_puzzle_steps << ".\n";
+                cout << "  -x  With -i, always simulate max_steps exactly.\n";
+                cout << "  -l  With -i, count exactly with a HashLife quadtree instead.\n";
+                cout << "  -q  Count the plots reachable in exactly each of these step counts.\n";
+                cout << "  -d  Split the plots within max_steps at each of these subdivisions.\n";
+                cout << "      -q and -d share one search, run until nothing new is reached.\n";
                 cout << "  -n  Do not subdivide based on number of steps reached\n";
                 cout << "      This defaults to a value based on input size.\n";
                 cout << "  -t  Trisect output. Outputs 3x3 number of grids possible.\n";
@@ -673,18 +1431,96 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    std::ifstream input;
-    input.open(argv[optind]);
-    if (!input.is_open()) {
+    auto g = make_grid(argv[optind]);
+    if (!g.is_open()) {
         std::cerr << "Unable to open " << argv[optind] << "\n";
         return 1;
     }
 
     if (++optind < argc) {
-        max_steps = std::stoi(argv[optind]);
+        max_steps = std::stol(argv[optind]);
+        if (max_steps < 0) {
+            std::cerr << "Something went wrong with max_steps, it can't be negative\n";
+            return 1;
+        }
+    }
+
+    if (!num_threads) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // find start
+    const auto start_pos = g.find('S');
+    if (!start_pos) {
+        std::cout << "Couldn't find the start point!\n";
+        return 1;
+    }
+
+    node start{};
+    start.col = start_pos->first;
+    start.row = start_pos->second;
+
+    if (entry_fields) {
+        time_point t1 = steady_clock::now();
+        const auto run = [=](const auto &g) { return show_entry_fields(g, start); };
+        if constexpr (g_use_fixed_grids) {
+            dispatch_grid<g_fixed_sizes>(g, run);
+        } else {
+            run(g);
+        }
+        time_point t2 = steady_clock::now();
+
+        cout << "time: " << duration<double>(t2 - t1).count() << "\n";
+        return 0;
     }
 
-    if (max_steps > 1024) {
+    if (infinite) {
+        if (!max_steps) {
+            max_steps = g_puzzle_steps;
+        }
+
+        time_point t1 = steady_clock::now();
+        std::optional<uint64_t> total;
+        if (quadtree) {
+            hashlife h(g, start);
+            total = h.count_after(max_steps);
+            cout << "quadtree nodes: " << h.num_nodes() << "\n";
+        } else {
+            total = count_cells_tiled(g, start, max_steps, exact_only);
+        }
+        time_point t2 = steady_clock::now();
+
+        if (!total) {
+            std::cerr << "Can't simulate " << max_steps << " steps in memory\n";
+            return 1;
+        }
+        cout << *total << "\n";
+        cout << "time: " << duration<double>(t2 - t1).count() << "\n";
+        return 0;
+    }
+
+    if (!step_queries.empty() || !split_queries.empty()) {
+        if (!max_steps) {
+            max_steps = std::max(g.height(), g.width()) - 1;
+        }
+
+        time_point t1 = steady_clock::now();
+        const auto run = [&](const auto &g) {
+            return answer_queries(g, start, max_steps, eng, num_threads, step_queries, split_queries);
+        };
+        if constexpr (g_use_fixed_grids) {
+            dispatch_grid<g_fixed_sizes>(g, run);
+        } else {
+            run(g);
+        }
+        time_point t2 = steady_clock::now();
+
+        cout << "time: " << duration<double>(t2 - t1).count() << "\n";
+        return 0;
+    }
+
+    // only the pathfinder keeps a distance per plot
+    if (eng == engine::pathfinder && max_steps > 1024) {
         std::cerr << "Max steps seems too big: " << max_steps << "\n";
         return 1;
     }
@@ -693,7 +1529,6 @@ int main(int argc, char **argv)
         subdivide = std::stoi(argv[optind]);
     }
 
-    auto g = make_grid(input);
     auto H = g.height(), W = g.width();
 
     if (!max_steps) {
@@ -706,31 +1541,26 @@ int main(int argc, char **argv)
         subdivide = 0; // disable
     }
 
-    // find start
-    node start{};
-    for (pos_t j = 0; j < H; j++) {
-        for (pos_t i = 0; i < W; i++) {
-            if (g.at(i, j) == 'S') {
-                start.row = j;
-                start.col = i;
-                start.type = node::start;
-            }
+    time_point t1 = steady_clock::now();
+    const auto allocs_before = alloc_count();
+
+    const auto run = [=](const auto &g) {
+        switch (eng) {
+            case engine::bitset:
+                return count_cells_bitset(g, start, max_steps, trisect, subdivide);
+            case engine::parallel:
+                return count_cells_parallel(g, start, max_steps, subdivide, num_threads);
+            default:
+                return count_cells_recursive(g, start, max_steps, trisect, subdivide);
         }
+    };
+    unsigned long dist;
+    if constexpr (g_use_fixed_grids) {
+        dist = dispatch_grid<g_fixed_sizes>(g, run);
+    } else {
+        dist = run(g);
     }
 
-    if (start.type != node::start) {
-        std::cout << "Couldn't find the start point!\n";
-        return 1;
-    }
-
-    // now that we know we found it, reset to type=normal to avoid
-    // splintering the multiverse
-    start.type = node::normal;
-
-    time_point t1 = steady_clock::now();
-
-    unsigned long dist = count_cells_recursive(g, start, max_steps, trisect, subdivide);
-
     time_point t2 = steady_clock::now();
 
     if (!subdivide) {
@@ -739,6 +1569,9 @@ int main(int argc, char **argv)
     }
 
     cout << "time: " << duration<double>(t2 - t1).count() << "\n";
+    if constexpr (g_show_stats) {
+        cout << "heap allocations: " << alloc_count() - allocs_before << "\n";
+    }
 
     return 0;
 }
@@ -7,7 +7,6 @@
 #include <concepts>
 #include <cstdint>
 #include <cstdlib>
-#include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
@@ -15,7 +14,9 @@
 #include <limits>
 #include <map>
 #include <numeric>
+#include <optional>
 #include <queue>
+#include <span>
 #include <string>
 #include <string_view>
 #include <tuple>
@@ -29,6 +30,11 @@
 
 #include <unistd.h>
 
+#include "alloc_count.h"
+#include "grid.h"
+#include "mapped_grid.h"
+#include "maze_junctions.h"
+
 // config
 
 static const bool g_show_input = false;
@@ -42,7 +48,6 @@ using std::tuple;
 using std::unordered_map;
 using std::vector;
 
-enum class Dir { west, east, north, south };
 using pos_t = int;
 
 struct node
@@ -74,115 +79,6 @@ struct std::hash<node>
     }
 };
 
-// coordinate system:
-// leftmost character is 0, increases by 1 each character going to the right
-// topmost character is 0, increases by 1 each additional line down
-template <std::integral T>
-struct grid
-{
-    using container_t = vector<char>;
-    using pos_t       = T;
-    using bounds_t    = std::tuple<pos_t, pos_t, int>; // start, end, step
-
-    void add_line(const std::string &line);
-
-    bounds_t steps_for_dir(const pos_t pos, const Dir dir) const;
-    container_t extract_line(const pos_t pos, const Dir dir) const;
-    void set_line(const container_t &line, const pos_t pos, const Dir dir);
-    char at(const pos_t col, const pos_t row) const;
-
-    pos_t height() const { return m_height; }
-    pos_t width() const { return m_width; }
-    std::string_view view() const { return std::string_view(m_grid.data(), m_width * m_height); }
-
-    void dump_grid() const;
-
-    public:
-    container_t m_grid;
-    pos_t m_width = 0, m_height = 0;
-};
-
-//{{{
-template <std::integral T>
-void grid<T>::add_line(const std::string &line)
-{
-    if(!m_width) { m_width = line.size(); }
-    std::copy(line.begin(), line.end(), std::back_inserter(m_grid));
-    m_height++;
-}
-
-template <std::integral T>
-void grid<T>::dump_grid() const
-{
-    using std::cout;
-    cout << "grid: " << m_width << "x" << m_height << "\n";
-    for(pos_t row = 0; row < m_height; row++) {
-        const auto it = &m_grid[row * m_width];
-        std::copy(it, it + m_width, std::ostream_iterator<char>(cout));
-        cout << "\n";
-    }
-}
-
-// common code for iterating across a column or row
-template <std::integral T>
-auto grid<T>::steps_for_dir(const pos_t pos, const Dir dir) const
--> bounds_t
-{
-    pos_t start = 0, end = 0;
-    int stride = 1; // can be negative
-
-    // we will iterate up to AND INCLUDING the end
-    if (dir == Dir::east || dir == Dir::west) {
-        start = pos * m_width;
-        end = (pos + 1) * m_width - 1;
-    } else {
-        start = pos;
-        end = pos + m_width * (m_height - 1);
-        stride = m_width;
-    }
-
-    if (dir == Dir::north || dir == Dir::west) {
-        stride *= -1;
-        std::swap(start, end);
-    }
-
-    end += stride; // so we can abort as soon as we see this
-
-    return std::make_tuple(start, end, stride);
-}
-
-template <std::integral T>
-auto grid<T>::extract_line(const pos_t pos, const Dir dir) const
--> container_t
-{
-    container_t result;
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    for (pos_t i = start; i != end; i += stride) {
-        result.push_back(m_grid[i]);
-    }
-
-    return result;
-}
-
-template <std::integral T>
-void grid<T>::set_line(const container_t &line, const pos_t pos, const Dir dir)
-{
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    auto it = line.begin();
-    for (pos_t i = start; i != end; i += stride) {
-        m_grid[i] = *it++;
-    }
-}
-
-template <std::integral T>
-char grid<T>::at(const pos_t col, const pos_t row) const
-{
-    return m_grid[row * m_width + col];
-}
-//}}}
-
 static std::ostream& operator <<(std::ostream &os, const node &n)
 {
     std::ios::fmtflags os_flags(os.flags());
@@ -203,18 +99,11 @@ static std::ostream& operator <<(std::ostream &os, const node &n)
     return os;
 }
 
-static auto make_grid(std::ifstream &input) -> grid<uint16_t>
+static auto make_grid(const char *filename) -> mapped_grid<uint16_t>
 {
-    std::string line;
-    grid<uint16_t> g;
+    mapped_grid<uint16_t> g(filename);
 
-    while (!input.eof() && std::getline(input, line)) {
-        g.add_line(line);
-    }
-
-    input.close();
-
-    if constexpr (g_show_input) {
+    if (g_show_input && g.is_open()) {
         g.dump_grid();
         std::cout << "\n";
     }
@@ -224,7 +113,7 @@ static auto make_grid(std::ifstream &input) -> grid<uint16_t>
 
 struct pathfinder
 {
-    pathfinder(const grid<uint16_t> &g)
+    pathfinder(const mapped_grid<uint16_t> &g)
         : m_g(g)
         , W(g.width())
         , H(g.height())
@@ -236,33 +125,9 @@ struct pathfinder
     pathfinder &set_doublestep(bool do_doublestep) { m_use_doublesteps = do_doublestep; return *this; };
 
     // support routines
-    vector<std::pair<int, int>> neighbor_dirs_one_step() const {
-        static const std::array checkers {
-            -1, 0, 1, 0, 0, -1, 0, 1
-        };
-
-        vector<std::pair<int, int>> dirs;
-        for (size_t i = 0; i < checkers.size() / 2; i++) {
-            dirs.emplace_back(checkers[i * 2], checkers[i * 2 + 1]);
-        }
-
-        return dirs;
-    }
+    std::span<const steps::offset> neighbor_dirs_one_step() const { return steps::one; }
 
-    vector<std::pair<int, int>> neighbor_dirs_for_node() const {
-        static const std::array checkers {
-            -2, 0,  2, 0 , 0, 2,  0, -2 ,
-            -1, 1, -1, -1, 1, 1,  1, -1,
-            0, 0  // go away and back is valid
-        };
-
-        vector<std::pair<int, int>> dirs;
-        for (size_t i = 0; i < checkers.size() / 2; i++) {
-            dirs.emplace_back(checkers[i * 2], checkers[i * 2 + 1]);
-        }
-
-        return dirs;
-    }
+    std::span<const steps::offset> neighbor_dirs_for_node() const { return steps::two; }
 
     bool hit_rock_dirs(int dist, pos_t cx, pos_t cy, int dx, int dy);
     bool hit_rock(int dist, pos_t nx, pos_t ny);
@@ -293,7 +158,7 @@ struct pathfinder
     }
 
     // input
-    const grid<uint16_t> &m_g;
+    const mapped_grid<uint16_t> &m_g;
 
     // problem state
 //  vector<int> distances;
@@ -456,10 +321,11 @@ void pathfinder::find_min_path(const node start)
 
         vector<node> visit_slopes; // otherwise what slopes to visit?
 
+        vector<pair<pos_t, pos_t>> next_paths; // reused for each step
         while(visit_slopes.empty()) {
             // Go through all possible directions and find the next step in
             // path or the slopes to visit
-            vector<pair<pos_t, pos_t>> next_paths;
+            next_paths.clear();
             const auto neighbors = m_use_doublesteps
                 ? neighbor_dirs_for_node()
                 : neighbor_dirs_one_step();
@@ -656,8 +522,118 @@ static void draw_color_grid(const pathfinder &p)
     cout << "\n";
 }
 
-static unsigned long count_cells_recursive(const grid<uint16_t> &g, node start)
+// The corridors contracted to the junctions between them, numbered in
+// reading order, with the start and end counting as junctions. A corridor
+// can't be walked against a slope, so the edges are one way, in CSR form:
+// the edges out of junction i are targets[k], weights[k] for k in
+// [offsets[i], offsets[i + 1]). The slopes all point down or right, so the
+// graph is a DAG and the longest path is one pass in topological order.
+struct junction_dag
+{
+    junction_dag(const mapped_grid<uint16_t> &g, node start, node end);
+
+    // -1 if the end can't be reached, nullopt if the graph has a cycle
+    std::optional<int> longest_path() const;
+
+    vector<node> nodes;
+    std::map<pair<pos_t, pos_t>, int> ids; // by row, col
+    int start_id = -1, end_id = -1;
+
+    vector<uint32_t> offsets;
+    vector<uint32_t> targets;
+    vector<int> weights;
+};
+
+// would stepping dx, dy onto cell go up a slope?
+static bool against_slope(const char cell, const int dx, const int dy)
+{
+    return (dx == -1 && cell == '>') || (dx == 1 && cell == '<')
+        || (dy == -1 && cell == 'v') || (dy == 1 && cell == '^');
+}
+
+// see maze_junctions, the slopes only come into the corridor walks
+junction_dag::junction_dag(const mapped_grid<uint16_t> &g, const node start, const node end)
+{
+    const maze_junctions mj(g, { { start.col, start.row }, { end.col, end.row } });
+
+    mj.for_each_junction([this](int col, int row) {
+        ids.emplace(pair(row, col), nodes.size());
+        nodes.push_back(node { .row = row, .col = col });
+    });
+    start_id = ids.at(pair(start.row, start.col));
+    end_id = ids.at(pair(end.row, end.col));
+
+    const auto may_step = [&g](int col, int row, int dx, int dy) {
+        return !against_slope(g.at(col, row), dx, dy);
+    };
+
+    offsets.reserve(nodes.size() + 1);
+    offsets.push_back(0);
+    for (const node n : nodes) {
+        for (const auto &[dx, dy] : steps::one) {
+            if (const auto c = mj.walk(n.col, n.row, dx, dy, may_step)) {
+                targets.push_back(ids.at(pair(c->row, c->col)));
+                weights.push_back(c->length);
+            }
+        }
+        offsets.push_back(targets.size());
+    }
+}
+
+std::optional<int> junction_dag::longest_path() const
 {
+    const std::size_t n = nodes.size();
+
+    // Kahn's algorithm, the order doubling as the queue
+    vector<int> in_degree(n, 0);
+    for (const auto t : targets) {
+        in_degree[t]++;
+    }
+    vector<int> order;
+    order.reserve(n);
+    for (std::size_t j = 0; j < n; j++) {
+        if (!in_degree[j]) {
+            order.push_back(j);
+        }
+    }
+    for (std::size_t i = 0; i < order.size(); i++) {
+        const int u = order[i];
+        for (uint32_t k = offsets[u]; k < offsets[u + 1]; k++) {
+            if (!--in_degree[targets[k]]) {
+                order.push_back(targets[k]);
+            }
+        }
+    }
+    if (order.size() < n) {
+        return std::nullopt;
+    }
+
+    vector<int> dist(n, -1);
+    dist[start_id] = 0;
+    for (const int u : order) {
+        if (dist[u] < 0) {
+            continue;
+        }
+        for (uint32_t k = offsets[u]; k < offsets[u + 1]; k++) {
+            dist[targets[k]] = std::max(dist[targets[k]], dist[u] + weights[k]);
+        }
+    }
+
+    return dist[end_id];
+}
+
+static unsigned long count_cells_recursive(const mapped_grid<uint16_t> &g, node start, bool use_dag)
+{
+    // Only the search below has a distance per slope to draw, and the end
+    // nodes it finds to report, so the DAG prints just the answer.
+    if (use_dag) {
+        const junction_dag dag(g, start, node { .row = g.height() - 1, .col = g.width() - 2 });
+        if (const auto dist = dag.longest_path()) {
+            return std::max(0, *dist);
+        }
+        std::cerr << "The corridors loop back, searching the slopes instead\n";
+    }
+
     pathfinder p(g);
     node end{ g.height() - 1, g.width() - 2 };
     end.type = node::end;
@@ -675,14 +651,21 @@ int main(int argc, char **argv)
     using namespace std::chrono;
     using std::cout;
 
+    bool use_dag = true;
     int opt;
-    while ((opt = getopt(argc, argv, "h")) != -1) {
+    while ((opt = getopt(argc, argv, "mh")) != -1) {
         switch(opt) {
+            case 'm':
+                use_dag = false;
+                break;
             default:
                 std::cerr << "Something went wrong with getopt\n";
                 return 1;
             case 'h':
-                cout << "usage: " << argv[0] << " filename\n";
+                cout << "usage: " << argv[0] << " [-m] filename\n";
+                cout << "  -m  Search from slope to slope with the map-based priority queue instead\n";
+                cout << "      of the DAG of junctions. Draws the grid coloured by distance,\n";
+                cout << "      which the DAG doesn't keep.\n";
                 return 0;
         }
     }
@@ -692,14 +675,12 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    std::ifstream input;
-    input.open(argv[optind]);
-    if (!input.is_open()) {
+    auto g = make_grid(argv[optind]);
+    if (!g.is_open()) {
         std::cerr << "Unable to open " << argv[optind] << "\n";
         return 1;
     }
 
-    auto g = make_grid(input);
 
 //  draw_color_grid(g);
 
@@ -707,13 +688,17 @@ int main(int argc, char **argv)
     node start{ 0, 1 };
 
     time_point t1 = steady_clock::now();
+    const auto allocs_before = alloc_count();
 
-    unsigned long dist = count_cells_recursive(g, start);
+    unsigned long dist = count_cells_recursive(g, start, use_dag);
 
     time_point t2 = steady_clock::now();
 
     cout << "dist: " << dist << "\n";
     cout << "time: " << duration<double>(t2 - t1).count() << "\n";
+    if constexpr (g_show_stats) {
+        cout << "heap allocations: " << alloc_count() - allocs_before << "\n";
+    }
 
     return 0;
 }
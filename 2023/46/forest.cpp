@@ -3,21 +3,29 @@
 // Grid stuff
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
 #include <concepts>
 #include <cstdint>
 #include <cstdlib>
-#include <fstream>
+#include <cstring>
+#include <deque>
 #include <functional>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <limits>
 #include <map>
+#include <mutex>
 #include <numeric>
+#include <optional>
 #include <queue>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
@@ -29,12 +37,19 @@
 
 #include <unistd.h>
 
+#include "alloc_count.h"
+#include "grid.h"
+#include "mapped_grid.h"
+#include "maze_junctions.h"
+
 // config
 
 static const bool g_show_input = false;
 static const bool g_draw_grid = false;
 static const bool g_show_stats = false;
 static const bool g_dump_edges = false;
+static const int g_split_depth = 8;   // parallel search, default levels split up front
+static const int g_share_levels = 6;  // and levels below that it still hands out work
 
 // common types
 
@@ -44,7 +59,6 @@ using std::tuple;
 using std::unordered_map;
 using std::vector;
 
-enum class Dir { west, east, north, south };
 using pos_t = int;
 
 struct node
@@ -74,115 +88,6 @@ struct std::hash<node>
     }
 };
 
-// coordinate system:
-// leftmost character is 0, increases by 1 each character going to the right
-// topmost character is 0, increases by 1 each additional line down
-template <std::integral T>
-struct grid
-{
-    using container_t = vector<char>;
-    using pos_t       = T;
-    using bounds_t    = std::tuple<pos_t, pos_t, int>; // start, end, step
-
-    void add_line(const std::string &line);
-
-    bounds_t steps_for_dir(const pos_t pos, const Dir dir) const;
-    container_t extract_line(const pos_t pos, const Dir dir) const;
-    void set_line(const container_t &line, const pos_t pos, const Dir dir);
-    char at(const pos_t col, const pos_t row) const;
-
-    pos_t height() const { return m_height; }
-    pos_t width() const { return m_width; }
-    std::string_view view() const { return std::string_view(m_grid.data(), m_width * m_height); }
-
-    void dump_grid() const;
-
-    public:
-    container_t m_grid;
-    pos_t m_width = 0, m_height = 0;
-};
-
-//{{{
-template <std::integral T>
-void grid<T>::add_line(const std::string &line)
-{
-    if(!m_width) { m_width = line.size(); }
-    std::copy(line.begin(), line.end(), std::back_inserter(m_grid));
-    m_height++;
-}
-
-template <std::integral T>
-void grid<T>::dump_grid() const
-{
-    using std::cout;
-    cout << "grid: " << m_width << "x" << m_height << "\n";
-    for(pos_t row = 0; row < m_height; row++) {
-        const auto it = &m_grid[row * m_width];
-        std::copy(it, it + m_width, std::ostream_iterator<char>(cout));
-        cout << "\n";
-    }
-}
-
-// common code for iterating across a column or row
-template <std::integral T>
-auto grid<T>::steps_for_dir(const pos_t pos, const Dir dir) const
--> bounds_t
-{
-    pos_t start = 0, end = 0;
-    int stride = 1; // can be negative
-
-    // we will iterate up to AND INCLUDING the end
-    if (dir == Dir::east || dir == Dir::west) {
-        start = pos * m_width;
-        end = (pos + 1) * m_width - 1;
-    } else {
-        start = pos;
-        end = pos + m_width * (m_height - 1);
-        stride = m_width;
-    }
-
-    if (dir == Dir::north || dir == Dir::west) {
-        stride *= -1;
-        std::swap(start, end);
-    }
-
-    end += stride; // so we can abort as soon as we see this
-
-    return std::make_tuple(start, end, stride);
-}
-
-template <std::integral T>
-auto grid<T>::extract_line(const pos_t pos, const Dir dir) const
--> container_t
-{
-    container_t result;
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    for (pos_t i = start; i != end; i += stride) {
-        result.push_back(m_grid[i]);
-    }
-
-    return result;
-}
-
-template <std::integral T>
-void grid<T>::set_line(const container_t &line, const pos_t pos, const Dir dir)
-{
-    const auto &[start, end, stride] = steps_for_dir(pos, dir);
-
-    auto it = line.begin();
-    for (pos_t i = start; i != end; i += stride) {
-        m_grid[i] = *it++;
-    }
-}
-
-template <std::integral T>
-char grid<T>::at(const pos_t col, const pos_t row) const
-{
-    return m_grid[row * m_width + col];
-}
-//}}}
-
 static std::ostream& operator <<(std::ostream &os, const node &n)
 {
     std::ios::fmtflags os_flags(os.flags());
@@ -201,18 +106,14 @@ static std::ostream& operator <<(std::ostream &os, const node &n)
     return os;
 }
 
-static auto make_grid(std::ifstream &input) -> grid<uint16_t>
-{
-    std::string line;
-    grid<uint16_t> g;
-
-    while (!input.eof() && std::getline(input, line)) {
-        g.add_line(line);
-    }
+// longest path search to use
+enum class engine { maps, bitmask, parallel, frontier };
 
-    input.close();
+static auto make_grid(const char *filename) -> mapped_grid<uint16_t>
+{
+    mapped_grid<uint16_t> g(filename);
 
-    if constexpr (g_show_input) {
+    if (g_show_input && g.is_open()) {
         g.dump_grid();
         std::cout << "\n";
     }
@@ -222,7 +123,7 @@ static auto make_grid(std::ifstream &input) -> grid<uint16_t>
 
 struct pathfinder
 {
-    pathfinder(const grid<uint16_t> &g)
+    pathfinder(const mapped_grid<uint16_t> &g)
         : m_g(g)
         , W(g.width())
         , H(g.height())
@@ -232,18 +133,7 @@ struct pathfinder
     void find_intersections(const node start);
 
     // support routines
-    vector<std::pair<int, int>> neighbor_dirs_one_step() const {
-        static const std::array checkers {
-            -1, 0, 1, 0, 0, -1, 0, 1
-        };
-
-        vector<std::pair<int, int>> dirs;
-        for (size_t i = 0; i < checkers.size() / 2; i++) {
-            dirs.emplace_back(checkers[i * 2], checkers[i * 2 + 1]);
-        }
-
-        return dirs;
-    }
+    std::span<const steps::offset> neighbor_dirs_one_step() const { return steps::one; }
 
     bool hit_rock(pos_t nx, pos_t ny);
 
@@ -268,7 +158,7 @@ struct pathfinder
     };
 
     // input
-    const grid<uint16_t> &m_g;
+    const mapped_grid<uint16_t> &m_g;
 
     // problem state
     std::map<node, int> distances;
@@ -356,10 +246,11 @@ void pathfinder::find_intersections(const node start)
         // used to keep moving until we find another node to visit
         vector<std::tuple<node, int, int>> visit_slopes;
 
+        vector<pair<pos_t, pos_t>> next_paths; // reused for each step
         while(visit_slopes.empty()) {
             // Go through all possible directions and find the next step in
             // path or the slopes to visit
-            vector<pair<pos_t, pos_t>> next_paths;
+            next_paths.clear();
             const auto neighbors = neighbor_dirs_one_step();
 
             for (const auto &new_dir : as_const(neighbors)) {
@@ -560,8 +451,694 @@ static unsigned dist_to_end(
     return max_dist;
 }
 
-static unsigned long count_cells_recursive(const grid<uint16_t> &g, node start)
+// The maze contracted to its junctions, numbered 0..n-1 in reading order,
+// with the corridors between them as edges in CSR form: the edges out of
+// junction i are targets[k], weights[k] for k in [offsets[i], offsets[i + 1]),
+// heaviest first. The start and end count as junctions. Up to
+// max_junctions, the searches keep the visited set as one bit per
+// junction.
+struct junction_graph
+{
+    static constexpr std::size_t max_junctions = 64;
+
+    junction_graph(const mapped_grid<uint16_t> &g, node start, node end);
+
+    std::size_t size() const { return nodes.size(); }
+    int id(const node n) const { return ids.at(n); }
+
+    // The most a path from cur can still add, or -1 if it can't get to
+    // dest: every junction it enters costs at most its heaviest edge, and
+    // it can only enter the ones reachable from cur without crossing
+    // visited.
+    int remaining_bound(int cur, uint64_t visited, int dest) const;
+
+    vector<node> nodes;
+    std::map<node, int> ids;
+    vector<uint32_t> offsets;
+    vector<uint32_t> targets;
+    vector<int> weights;
+
+    vector<uint64_t> neighbours; // per junction as a mask, up to max_junctions
+    vector<int> max_weight;      // per junction, its heaviest edge
+};
+
+// In one pass over the grid, see maze_junctions
+junction_graph::junction_graph(const mapped_grid<uint16_t> &g, const node start, const node end)
+{
+    const maze_junctions mj(g, { { start.col, start.row }, { end.col, end.row } });
+
+    mj.for_each_junction([this](int col, int row) {
+        const node n { .row = row, .col = col };
+        ids.emplace(n, nodes.size());
+        nodes.push_back(n);
+    });
+
+    offsets.reserve(nodes.size() + 1);
+    offsets.push_back(0);
+    vector<pair<int, int>> out_edges; // weight, target
+    for (std::size_t j = 0; j < nodes.size(); j++) {
+        out_edges.clear();
+
+        for (const auto &[dx, dy] : steps::one) {
+            if (const auto c = mj.walk(nodes[j].col, nodes[j].row, dx, dy)) {
+                out_edges.emplace_back(c->length, ids.at(node { .row = c->row, .col = c->col }));
+            }
+        }
+
+        // long paths first, so that the bounded search has a good one to
+        // cut against early
+        std::sort(out_edges.begin(), out_edges.end(), std::greater<>());
+
+        uint64_t mask = 0;
+        for (const auto &[dist, dest] : out_edges) {
+            targets.push_back(dest);
+            weights.push_back(dist);
+            mask |= dest < int(max_junctions) ? uint64_t(1) << dest : 0;
+        }
+        offsets.push_back(targets.size());
+        neighbours.push_back(mask);
+        max_weight.push_back(out_edges.empty() ? 0 : out_edges.front().first);
+    }
+}
+
+int junction_graph::remaining_bound(const int cur, const uint64_t visited, const int dest) const
+{
+    const uint64_t open = ~visited & ~(uint64_t(1) << cur);
+    uint64_t reached = neighbours[cur] & open;
+    uint64_t frontier = reached;
+
+    while (frontier) {
+        const int v = std::countr_zero(frontier);
+        frontier &= frontier - 1;
+        const uint64_t added = neighbours[v] & open & ~reached;
+        reached |= added;
+        frontier |= added;
+    }
+
+    if (!(reached & (uint64_t(1) << dest))) {
+        return -1;
+    }
+
+    int total = 0;
+    for (uint64_t m = reached; m; m &= m - 1) {
+        total += max_weight[std::countr_zero(m)];
+    }
+    return total;
+}
+
+// Same search as above with the visited junctions as a bit mask, passed by
+// value so there is nothing to undo. Returns -1 if dest can't be reached.
+static int dist_to_end(const junction_graph &jg, const int dest, const int cur, const uint64_t visited,
+        uint_fast64_t &num_nodes)
+{
+    num_nodes++;
+    if (cur == dest) {
+        return 0;
+    }
+
+    const uint64_t now_visited = visited | (uint64_t(1) << cur);
+    int max_dist = -1;
+
+    for (uint32_t k = jg.offsets[cur]; k < jg.offsets[cur + 1]; k++) {
+        const int next = jg.targets[k];
+        if (now_visited & (uint64_t(1) << next)) {
+            continue;
+        }
+
+        const int rest = dist_to_end(jg, dest, next, now_visited, num_nodes);
+        if (rest >= 0) {
+            max_dist = std::max(max_dist, jg.weights[k] + rest);
+        }
+    }
+
+    return max_dist;
+}
+
+// Branch and bound version: dist is the length of the path to cur, and
+// best the longest full path found so far. Subtrees that can't add enough
+// to beat best, by remaining_bound(), aren't searched.
+static void longest_path_bounded(const junction_graph &jg, const int dest, const int cur,
+        const uint64_t visited, const int dist, int &best, uint_fast64_t &num_nodes)
+{
+    num_nodes++;
+    if (cur == dest) {
+        best = std::max(best, dist);
+        return;
+    }
+
+    const uint64_t now_visited = visited | (uint64_t(1) << cur);
+    const int bound = jg.remaining_bound(cur, now_visited, dest);
+    if (bound < 0 || dist + bound <= best) {
+        return;
+    }
+
+    for (uint32_t k = jg.offsets[cur]; k < jg.offsets[cur + 1]; k++) {
+        const int next = jg.targets[k];
+        if (!(now_visited & (uint64_t(1) << next))) {
+            longest_path_bounded(jg, dest, next, now_visited, dist + jg.weights[k], best, num_nodes);
+        }
+    }
+}
+
+// The bit mask search spread over threads. The search tree is expanded
+// split_depth levels down up front, and the subproblems are dealt out to
+// per thread deques. Threads take from the back of their own and steal
+// from the front of others', where the bigger subproblems are. While any
+// thread is idle the others also hand out the children they haven't
+// started near the top of their subtree, so that one deep subtree doesn't
+// end up as one thread's work.
+//
+// With prune set, the longest path found so far is shared between threads
+// and every subtree is bounded against it as in longest_path_bounded.
+class parallel_search
+{
+    public:
+    parallel_search(const junction_graph &jg, int dest, unsigned num_threads, bool prune)
+        : m_jg(jg)
+        , m_dest(dest)
+        , m_num_threads(std::max(1u, num_threads))
+        , m_prune(prune)
+        , m_queues(m_num_threads)
+    {
+    }
+
+    parallel_search(const parallel_search &) = delete;
+    parallel_search &operator=(const parallel_search &) = delete;
+
+    // -1 if dest can't be reached
+    int longest_path(int start, int split_depth);
+
+    // stats
+    std::atomic<uint_fast64_t> num_tasks = 0, num_shared = 0, num_steals = 0;
+    std::atomic<uint_fast64_t> num_nodes = 0;
+
+    private:
+    struct task
+    {
+        int cur;
+        uint64_t visited; // not including cur
+        int dist;         // from the start to cur
+        int depth;
+    };
+
+    struct task_queue
+    {
+        std::mutex lock;
+        std::deque<task> tasks;
+    };
+
+    void split(const task &t, int split_depth, vector<task> &out);
+    void search(const task &t, unsigned thread, uint_fast64_t &nodes);
+    void push(unsigned thread, const task &t);
+    bool pop(unsigned thread, task &t);
+    void worker(unsigned thread);
+
+    // raises m_best to d if it was lower
+    void offer(int d) {
+        int old = m_best.load(std::memory_order_relaxed);
+        while (d > old && !m_best.compare_exchange_weak(old, d, std::memory_order_relaxed)) {
+        }
+    }
+
+    const junction_graph &m_jg;
+    const int m_dest;
+    const unsigned m_num_threads;
+    const bool m_prune;
+    int m_share_depth = 0;
+
+    vector<task_queue> m_queues;
+    std::atomic<int> m_best = -1;
+    std::atomic<long> m_pending = 0;    // tasks queued or running
+    std::atomic<unsigned> m_idle = 0;   // threads looking for work
+};
+
+// the tasks split_depth levels below t, or fewer where the path ends
+void parallel_search::split(const task &t, const int split_depth, vector<task> &out)
+{
+    if (t.depth == split_depth) {
+        out.push_back(t); // counted when it runs
+        return;
+    }
+
+    num_nodes.fetch_add(1, std::memory_order_relaxed);
+    if (t.cur == m_dest) {
+        offer(t.dist);
+        return;
+    }
+
+    const uint64_t now_visited = t.visited | (uint64_t(1) << t.cur);
+    for (uint32_t k = m_jg.offsets[t.cur]; k < m_jg.offsets[t.cur + 1]; k++) {
+        const int next = m_jg.targets[k];
+        if (!(now_visited & (uint64_t(1) << next))) {
+            split({ next, now_visited, t.dist + m_jg.weights[k], t.depth + 1 }, split_depth, out);
+        }
+    }
+}
+
+// offers the paths through t, children handed out to other threads offer
+// their own
+void parallel_search::search(const task &t, const unsigned thread, uint_fast64_t &nodes)
+{
+    nodes++;
+    if (t.cur == m_dest) {
+        offer(t.dist);
+        return;
+    }
+
+    const uint64_t now_visited = t.visited | (uint64_t(1) << t.cur);
+    if (m_prune) {
+        const int bound = m_jg.remaining_bound(t.cur, now_visited, m_dest);
+        if (bound < 0 || t.dist + bound <= m_best.load(std::memory_order_relaxed)) {
+            return;
+        }
+    }
+
+    const bool share = t.depth < m_share_depth;
+    for (uint32_t k = m_jg.offsets[t.cur]; k < m_jg.offsets[t.cur + 1]; k++) {
+        const int next = m_jg.targets[k];
+        if (now_visited & (uint64_t(1) << next)) {
+            continue;
+        }
+
+        const task child { next, now_visited, t.dist + m_jg.weights[k], t.depth + 1 };
+        if (share && m_idle.load(std::memory_order_relaxed)) {
+            push(thread, child);
+            num_shared.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        search(child, thread, nodes);
+    }
+}
+
+void parallel_search::push(const unsigned thread, const task &t)
 {
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard guard(m_queues[thread].lock);
+    m_queues[thread].tasks.push_back(t);
+}
+
+// the newest of the thread's own tasks, else the oldest of someone else's
+bool parallel_search::pop(const unsigned thread, task &t)
+{
+    {
+        std::lock_guard guard(m_queues[thread].lock);
+        auto &own = m_queues[thread].tasks;
+        if (!own.empty()) {
+            t = own.back();
+            own.pop_back();
+            return true;
+        }
+    }
+
+    for (unsigned i = 1; i < m_num_threads; i++) {
+        auto &victim = m_queues[(thread + i) % m_num_threads];
+        std::lock_guard guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            t = victim.tasks.front();
+            victim.tasks.pop_front();
+            num_steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void parallel_search::worker(const unsigned thread)
+{
+    uint_fast64_t nodes = 0;
+    bool idle = false;
+
+    // a running task's children are pushed before it finishes, so nothing
+    // is left once the count is zero
+    while (m_pending.load(std::memory_order_acquire) > 0) {
+        task t;
+        if (!pop(thread, t)) {
+            if (!idle) {
+                m_idle.fetch_add(1, std::memory_order_relaxed);
+                idle = true;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        if (idle) {
+            m_idle.fetch_sub(1, std::memory_order_relaxed);
+            idle = false;
+        }
+
+        search(t, thread, nodes);
+        num_tasks.fetch_add(1, std::memory_order_relaxed);
+        m_pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    if (idle) {
+        m_idle.fetch_sub(1, std::memory_order_relaxed);
+    }
+    num_nodes.fetch_add(nodes, std::memory_order_relaxed);
+}
+
+int parallel_search::longest_path(const int start, const int split_depth)
+{
+    m_share_depth = split_depth + g_share_levels;
+
+    vector<task> tasks;
+    split({ start, 0, 0, 0 }, split_depth, tasks);
+
+    m_pending.store(tasks.size(), std::memory_order_relaxed);
+    for (std::size_t i = 0; i < tasks.size(); i++) {
+        m_queues[i % m_num_threads].tasks.push_back(tasks[i]);
+    }
+
+    {
+        // the calling thread works as thread 0
+        vector<std::jthread> workers;
+        for (unsigned t = 1; t < m_num_threads; t++) {
+            workers.emplace_back([this, t] { worker(t); });
+        }
+        worker(0);
+    }
+
+    return m_best.load();
+}
+
+// Longest path by dynamic programming over the edges instead of searching
+// (the frontier method of Knuth's SIMPATH). Edges are decided one at a
+// time, in or out of the path, and only the junctions on the frontier
+// matter for the rest: those with some edges decided and some not. A
+// partial choice is summed up by its profile, the mate of each frontier
+// junction, as a frontier position:
+//  - its own if it has no path edge yet
+//  - the far end of its piece of path if it has one
+//  - saturated if it has two (or is the start or dest, with one)
+// Positions rather than junction ids keep a profile small however many
+// junctions the maze has.
+// Choices with equal profiles finish the same ways, so only the longest is
+// kept. Junctions are ordered breadth first from the start, which on the
+// grid-like mazes keeps the frontier to about one diagonal of junctions,
+// so the number of profiles depends on the width of the maze rather than
+// on the number of paths.
+class frontier_dp
+{
+    public:
+    static constexpr std::size_t max_frontier = 16;
+
+    frontier_dp(const junction_graph &jg, int start, int dest);
+
+    // -1 if dest can't be reached, nullopt if the frontier gets too wide
+    std::optional<int> longest_path();
+
+    // stats
+    std::size_t max_width = 0, max_profiles = 0;
+
+    private:
+    using profile = std::array<uint8_t, max_frontier>; // mates by frontier position
+    static constexpr uint8_t saturated = 0xff;
+
+    struct profile_hash
+    {
+        std::size_t operator()(const profile &p) const noexcept {
+            uint64_t lo, hi;
+            std::memcpy(&lo, p.data(), 8);
+            std::memcpy(&hi, p.data() + 8, 8);
+            return (lo * 0x9E3779B97F4A7C15ull) ^ (hi + (lo >> 29)) * 0xBF58476D1CE4E5B9ull;
+        }
+    };
+
+    struct edge_step
+    {
+        uint8_t u, v;      // frontier positions of the ends
+        int weight;
+        vector<int> frontier;          // junction at each position
+        vector<uint8_t> next_from;     // position after this edge -> position now
+        vector<uint8_t> to_next;       // the other way, for those that stay
+        vector<uint8_t> leaving;       // positions with no edges left after this one
+        vector<uint8_t> ends_done;     // same for the start and dest, which stay
+    };
+
+    static int pos_of(const edge_step &e, int junction);
+
+    const int m_start, m_dest;
+    vector<edge_step> m_steps;
+    bool m_too_wide = false;
+};
+
+frontier_dp::frontier_dp(const junction_graph &jg, const int start, const int dest)
+    : m_start(start)
+    , m_dest(dest)
+{
+    const int n = jg.size();
+
+    // breadth first order from the start
+    vector<int> order(n, n);
+    vector<int> queue { start };
+    order[start] = 0;
+    for (std::size_t i = 0; i < queue.size(); i++) {
+        const int cur = queue[i];
+        for (uint32_t k = jg.offsets[cur]; k < jg.offsets[cur + 1]; k++) {
+            if (order[jg.targets[k]] == n) {
+                order[jg.targets[k]] = queue.size();
+                queue.push_back(jg.targets[k]);
+            }
+        }
+    }
+
+    // each edge once, by its later end then its earlier one
+    vector<tuple<int, int, int, int, int>> edges; // later, earlier, u, v, weight
+    for (int u = 0; u < n; u++) {
+        for (uint32_t k = jg.offsets[u]; k < jg.offsets[u + 1]; k++) {
+            const int v = jg.targets[k];
+            if (u < v) {
+                edges.emplace_back(std::max(order[u], order[v]), std::min(order[u], order[v]),
+                        u, v, jg.weights[k]);
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    vector<int> last_edge(n, -1);
+    for (std::size_t i = 0; i < edges.size(); i++) {
+        last_edge[std::get<2>(edges[i])] = i;
+        last_edge[std::get<3>(edges[i])] = i;
+    }
+
+    // the start and dest stay on the frontier throughout
+    vector<int> frontier { start, dest };
+    for (std::size_t i = 0; i < edges.size(); i++) {
+        const auto [later, earlier, u, v, weight] = edges[i];
+        for (const int j : { u, v }) {
+            if (std::find(frontier.begin(), frontier.end(), j) == frontier.end()) {
+                frontier.push_back(j);
+            }
+        }
+        if (frontier.size() > max_frontier) {
+            m_too_wide = true;
+            return;
+        }
+        max_width = std::max(max_width, frontier.size());
+
+        edge_step e { 0, 0, weight, frontier, {}, {}, {}, {} };
+        e.u = pos_of(e, u);
+        e.v = pos_of(e, v);
+
+        frontier.clear();
+        e.to_next.assign(e.frontier.size(), saturated);
+        for (std::size_t p = 0; p < e.frontier.size(); p++) {
+            const int j = e.frontier[p];
+            const bool is_end = j == start || j == dest;
+            if (last_edge[j] == int(i) && is_end) {
+                e.ends_done.push_back(p);
+            }
+            if (last_edge[j] == int(i) && !is_end) {
+                e.leaving.push_back(p);
+            } else {
+                e.to_next[p] = e.next_from.size();
+                e.next_from.push_back(p);
+                frontier.push_back(j);
+            }
+        }
+        m_steps.push_back(std::move(e));
+    }
+}
+
+int frontier_dp::pos_of(const edge_step &e, const int junction)
+{
+    return std::find(e.frontier.begin(), e.frontier.end(), junction) - e.frontier.begin();
+}
+
+std::optional<int> frontier_dp::longest_path()
+{
+    if (m_too_wide) {
+        return std::nullopt;
+    }
+    if (m_start == m_dest) {
+        return 0;
+    }
+    if (m_steps.empty()) {
+        return -1;
+    }
+
+    // positions 0 and 1 are always the start and dest
+    const auto is_loose_end = [](const profile &p, std::size_t pos) {
+        return pos > 1 && p[pos] != pos && p[pos] != saturated;
+    };
+    const auto is_end = [](uint8_t pos) { return pos < 2; };
+
+    int best = -1;
+    unordered_map<profile, int, profile_hash> cur, next;
+
+    profile empty {};
+    for (std::size_t p = 0; p < m_steps.front().frontier.size(); p++) {
+        empty[p] = p;
+    }
+    cur.emplace(empty, 0);
+
+    for (std::size_t i = 0; i < m_steps.size(); i++) {
+        const edge_step &e = m_steps[i];
+        const std::size_t width = e.frontier.size();
+
+        // the profile on the next step's frontier, if nothing is left
+        // hanging by the junctions this edge was the last of, and the
+        // start and dest still have a way in
+        next.clear();
+        const auto carry = [&](const profile &p, const int len) {
+            for (const auto l : e.leaving) {
+                if (is_loose_end(p, l)) {
+                    return;
+                }
+            }
+            for (const auto l : e.ends_done) {
+                if (p[l] != saturated) {
+                    return;
+                }
+            }
+
+            profile q {};
+            if (i + 1 < m_steps.size()) {
+                const auto &nf = m_steps[i + 1].frontier;
+                for (std::size_t k = 0; k < nf.size(); k++) {
+                    if (k >= e.next_from.size()) {
+                        q[k] = k;
+                    } else if (const uint8_t m = p[e.next_from[k]]; m != saturated) {
+                        q[k] = e.to_next[m];
+                    } else {
+                        q[k] = saturated;
+                    }
+                }
+            }
+            auto [it, added] = next.try_emplace(q, len);
+            if (!added) {
+                it->second = std::max(it->second, len);
+            }
+        };
+
+        for (const auto &[p, len] : cur) {
+            // without the edge
+            carry(p, len);
+
+            // with it, joining the pieces u and v are loose ends of (or
+            // start, if they have no edges yet) into one from a to b
+            const uint8_t a = p[e.u], b = p[e.v];
+            if (a == saturated || b == saturated || a == e.v) {
+                continue;
+            }
+
+            if (is_end(a) && is_end(b)) {
+                // a whole path, if it's the only piece
+                bool whole = true;
+                for (std::size_t k = 0; k < width && whole; k++) {
+                    whole = k == e.u || k == e.v || !is_loose_end(p, k);
+                }
+                if (whole) {
+                    best = std::max(best, len + e.weight);
+                }
+                continue;
+            }
+
+            // the start and dest take one edge, keeping the far end of
+            // their piece pointing at them
+            profile q = p;
+            q[e.u] = q[e.v] = saturated;
+            if (!is_end(a)) {
+                q[a] = b;
+            }
+            if (!is_end(b)) {
+                q[b] = a;
+            }
+            carry(q, len + e.weight);
+        }
+        std::swap(cur, next);
+        max_profiles = std::max(max_profiles, cur.size());
+    }
+
+    return best;
+}
+
+// the longest path over the junction graph, with any engine but maps
+static unsigned long count_cells_junctions(const junction_graph &jg, node start, node en, engine eng,
+        unsigned num_threads, int split_depth, bool prune)
+{
+    // speedup by looking for the penultimate node instead
+    int last_edge = 0;
+    int dest = jg.id(en);
+    if (jg.offsets[dest + 1] - jg.offsets[dest] == 1) {
+        last_edge = jg.weights[jg.offsets[dest]];
+        dest = jg.targets[jg.offsets[dest]];
+    }
+
+    int dist = -1;
+    if (eng == engine::bitmask) {
+        uint_fast64_t num_nodes = 0;
+        if (prune) {
+            longest_path_bounded(jg, dest, jg.id(start), 0, 0, dist, num_nodes);
+        } else {
+            dist = dist_to_end(jg, dest, jg.id(start), 0, num_nodes);
+        }
+
+        std::cout << "nodes explored: " << num_nodes << "\n";
+    } else if (eng == engine::frontier) {
+        frontier_dp dp(jg, jg.id(start), dest);
+        const auto found = dp.longest_path();
+        if (!found) {
+            std::cerr << "frontier wider than " << frontier_dp::max_frontier << " junctions\n";
+            return 0;
+        }
+        dist = *found;
+
+        std::cout << "frontier: " << dp.max_width << " junctions, " << dp.max_profiles << " profiles\n";
+    } else if (eng == engine::parallel) {
+        parallel_search ps(jg, dest, num_threads, prune);
+        dist = ps.longest_path(jg.id(start), split_depth);
+
+        std::cout << "threads: " << num_threads << ", subproblems: " << ps.num_tasks
+            << ", handed out: " << ps.num_shared << ", stolen: " << ps.num_steals << "\n";
+        std::cout << "nodes explored: " << ps.num_nodes << "\n";
+    }
+
+    if constexpr (g_dump_edges) {
+        for (std::size_t i = 0; i < jg.size(); i++) {
+            for (uint32_t k = jg.offsets[i]; k < jg.offsets[i + 1]; k++) {
+                std::cout << "Edge from " << jg.nodes[i] << " to "
+                    << jg.nodes[jg.targets[k]] << ", distance = " << jg.weights[k] << "\n";
+            }
+        }
+    }
+
+    return dist < 0 ? 0 : dist + last_edge;
+}
+
+static unsigned long count_cells_recursive(const mapped_grid<uint16_t> &g, node start, engine eng,
+        unsigned num_threads, int split_depth, bool prune)
+{
+    if (eng != engine::maps) {
+        const node en { .row = g.height() - 1, .col = g.width() - 2 };
+        const junction_graph jg(g, start, en);
+        // the frontier search keeps no visited set, and checks its own width
+        if (eng == engine::frontier || jg.size() <= junction_graph::max_junctions) {
+            return count_cells_junctions(jg, start, en, eng, num_threads, split_depth, prune);
+        }
+        std::cerr << jg.size() << " junctions, too many for the bit mask search\n";
+    }
+
     pathfinder p(g);
 
     p.find_intersections(start);
@@ -574,20 +1151,18 @@ static unsigned long count_cells_recursive(const grid<uint16_t> &g, node start)
     // all possible paths through the graph.
 
     node en = p.end_node();
-    std::unordered_map<node, bool> visited;
 
     // speedup by looking for the penultimate node instead
-    unsigned total_dist;
-
+    unsigned total_dist = 0;
+    node dest = en;
     if (p.edges[en].size() == 1) {
-        node penultimate = p.edges[en].begin()->first;
-
-        total_dist = dist_to_end(visited, p, penultimate, start);
-        total_dist += p.edges[en][penultimate];
-    } else {
-        total_dist = dist_to_end(visited, p, en, start);
+        dest = p.edges[en].begin()->first;
+        total_dist = p.edges[en][dest];
     }
 
+    std::unordered_map<node, bool> visited;
+    total_dist += dist_to_end(visited, p, dest, start);
+
     if constexpr (g_dump_edges) {
         for (const auto &edge : as_const(p.edges)) {
             const auto &[src, destmap] = edge;
@@ -607,14 +1182,48 @@ int main(int argc, char **argv)
     using namespace std::chrono;
     using std::cout;
 
+    engine eng = engine::bitmask;
+    unsigned num_threads = 0;
+    int split_depth = g_split_depth;
+    bool prune = true;
     int opt;
-    while ((opt = getopt(argc, argv, "h")) != -1) {
+    while ((opt = getopt(argc, argv, "mfp:s:uh")) != -1) {
         switch(opt) {
+            case 'm':
+                eng = engine::maps;
+                break;
+            case 'f':
+                eng = engine::frontier;
+                break;
+            case 'p':
+            case 's': {
+                const int n = std::stoi(optarg);
+                if (n < 0) {
+                    std::cerr << "Something went wrong with -" << char(opt) << ", it can't be negative\n";
+                    return 1;
+                }
+                if (opt == 'p') {
+                    eng = engine::parallel;
+                    num_threads = n;
+                } else {
+                    split_depth = n;
+                }
+                break;
+            }
+            case 'u':
+                prune = false;
+                break;
             default:
                 std::cerr << "Something went wrong with getopt\n";
                 return 1;
             case 'h':
-                cout << "usage: " << argv[0] << " filename\n";
+                cout << "usage: " << argv[0] << " [-m | -f | -p N [-s N]] [-u] filename\n";
+                cout << "  -m  Search the map-based junction graph instead of the bit mask one.\n";
+                cout << "  -f  Find the longest path by frontier dynamic programming instead.\n";
+                cout << "  -p  Search with N threads (0 for one per core).\n";
+                cout << "  -s  With -p, split the search into subproblems this many junctions\n";
+                cout << "      deep. Defaults to " << g_split_depth << ".\n";
+                cout << "  -u  Search every path, without branch and bound pruning.\n";
                 return 0;
         }
     }
@@ -624,14 +1233,16 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    std::ifstream input;
-    input.open(argv[optind]);
-    if (!input.is_open()) {
+    if (!num_threads) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    auto g = make_grid(argv[optind]);
+    if (!g.is_open()) {
         std::cerr << "Unable to open " << argv[optind] << "\n";
         return 1;
     }
 
-    auto g = make_grid(input);
 
 //  draw_color_grid(g);
 
@@ -639,13 +1250,17 @@ int main(int argc, char **argv)
     node start{ 0, 1 };
 
     time_point t1 = steady_clock::now();
+    const auto allocs_before = alloc_count();
 
-    unsigned long dist = count_cells_recursive(g, start);
+    unsigned long dist = count_cells_recursive(g, start, eng, num_threads, split_depth, prune);
 
     time_point t2 = steady_clock::now();
 
     cout << "dist: " << dist << "\n";
     cout << "time: " << duration<double>(t2 - t1).count() << "\n";
+    if constexpr (g_show_stats) {
+        cout << "heap allocations: " << alloc_count() - allocs_before << "\n";
+    }
 
     return 0;
 }
@@ -10,6 +10,8 @@
 #include <string_view>
 #include <vector>
 
+#include "grid.h"
+
 using std::array;
 using std::tuple;
 using std::cout;
@@ -22,12 +24,7 @@ using std::string_view;
 namespace stdr = std::ranges;
 namespace stdv = std::views;
 
-struct Grid
-{
-    string chars;
-    size_t w;
-    size_t h;
-};
+using Grid = grid<size_t>;
 
 static Grid get_input_lines(const string &fname)
 {
@@ -39,9 +36,7 @@ static Grid get_input_lines(const string &fname)
 
     string buf;
     while (std::getline(in_f, buf)) {
-        out.chars.append(buf);
-        out.h++;
-        out.w = buf.size();
+        out.add_line(buf);
     }
 
     return out;
@@ -58,19 +53,19 @@ int main(int argc, char *argv[])
 
     try {
         const Grid g = get_input_lines(fname);
-        cout << "Grid size: " << g.w << "," << g.h << "\n";
+        cout << "Grid size: " << g.width() << "," << g.height() << "\n";
 
-        vector<uint8_t> surrounding_count(g.chars.size(), 0);
+        vector<uint8_t> surrounding_count(g.m_grid.size(), 0);
 
         const auto dump_grid = [&surrounding_count](const Grid &g) {
-            for (size_t i = 0; i < g.h; i++) {
-                for (size_t j = 0; j < g.w; j++) {
-                    const size_t idx = j + i * g.w;
-                    if (g.chars[idx] == '@' && surrounding_count[idx] < 4) {
-                        cout << "\e[0;30m\e[46m" << (int) surrounding_count[j + i * g.w] << "\e[0m";
+            for (size_t i = 0; i < g.height(); i++) {
+                for (size_t j = 0; j < g.width(); j++) {
+                    const size_t idx = g.idx(j, i);
+                    if (g.m_grid[idx] == '@' && surrounding_count[idx] < 4) {
+                        cout << "\e[0;30m\e[46m" << (int) surrounding_count[idx] << "\e[0m";
                     }
                     else {
-                        cout << (int) surrounding_count[j + i * g.w];
+                        cout << (int) surrounding_count[idx];
                     }
                 }
                 cout << "\n";
@@ -78,13 +73,7 @@ int main(int argc, char *argv[])
             cout << "---\n\n";
         };
 
-        for (size_t i = 0; i < g.chars.size(); i++) {
-            if (g.chars[i] != '@') {
-                continue;
-            }
-            size_t c = i % g.w;
-            size_t r = i / g.w;
-
+        g.for_each('@', [&g, &surrounding_count](size_t c, size_t r) {
             using std::make_pair;
             const auto ring = array { // col, row
                 make_pair(-1, -1), make_pair( 0, -1), make_pair( 1, -1),
@@ -95,17 +84,17 @@ int main(int argc, char *argv[])
             for (const auto &[col, row] : ring) {
                 const size_t newc = c + col;
                 const size_t newr = r + row;
-                if (newc < g.w && newr < g.h) {
-                    surrounding_count[g.w * newr + newc]++;
+                if (newc < g.width() && newr < g.height()) {
+                    surrounding_count[g.idx(newc, newr)]++;
                 }
             }
-        }
+        });
 
         dump_grid(g);
 
         size_t sum = 0;
-        for (size_t i = 0; i < g.chars.size(); i++) {
-            if (g.chars[i] == '@' && surrounding_count[i] < 4) {
+        for (size_t i = 0; i < g.m_grid.size(); i++) {
+            if (g.m_grid[i] == '@' && surrounding_count[i] < 4) {
                 sum++;
             }
         }
@@ -1,11 +1,16 @@
 #include <array>
+#include <bit>
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <span>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "grid.h"
+#include "packed_grid.h"
+
 using std::array;
 using std::cout;
 using std::cerr;
@@ -14,16 +19,15 @@ using std::make_pair;
 using std::vector;
 using std::size_t;
 
-struct Grid
-{
-    string chars;
-    size_t w;
-    size_t h;
-};
+// Set to false to go back to the byte-per-cell grid with SWAR neighbor counts
+static constexpr bool use_packed_grid = true;
 
-static Grid get_input_lines(const string &fname)
+using Grid = grid<size_t>;
+using PackedGrid = packed_grid<1>; // 1 bit per cell, set for a roll
+
+template <class G>
+static void read_input_lines(const string &fname, G &out)
 {
-    Grid out;
     std::ifstream in_f(fname, std::ios::in);
     if (!in_f.is_open()) {
         throw std::runtime_error("Failed to open file");
@@ -31,27 +35,37 @@ static Grid get_input_lines(const string &fname)
 
     string buf;
     while (std::getline(in_f, buf)) {
-        out.chars.append(buf);
-        out.h++;
-        out.w = buf.size();
+        out.add_line(buf);
     }
+}
+
+static Grid get_input_lines(const string &fname)
+{
+    Grid out;
+    read_input_lines(fname, out);
+    return out;
+}
 
+static PackedGrid get_input_packed(const string &fname)
+{
+    PackedGrid out(".@");
+    read_input_lines(fname, out);
     return out;
 }
 
 static void find_rolls_free(const Grid &g, vector<uint8_t> &surrounding_count)
 {
-    surrounding_count.assign(g.chars.size(), 0);
+    surrounding_count.assign(g.m_grid.size(), 0);
 
     const auto dump_grid = [&surrounding_count](const Grid &g) {
-        for (size_t i = 0; i < g.h; i++) {
-            for (size_t j = 0; j < g.w; j++) {
-                const size_t idx = j + i * g.w;
-                if (g.chars[idx] == '@' && surrounding_count[idx] < 4) {
-                    cout << "\e[0;30m\e[46m" << (int) surrounding_count[j + i * g.w] << "\e[0m";
+        for (size_t i = 0; i < g.height(); i++) {
+            for (size_t j = 0; j < g.width(); j++) {
+                const size_t idx = g.idx(j, i);
+                if (g.m_grid[idx] == '@' && surrounding_count[idx] < 4) {
+                    cout << "\e[0;30m\e[46m" << (int) surrounding_count[idx] << "\e[0m";
                 }
                 else {
-                    cout << (int) surrounding_count[j + i * g.w];
+                    cout << (int) surrounding_count[idx];
                 }
             }
             cout << "\n";
@@ -66,15 +80,15 @@ static void find_rolls_free(const Grid &g, vector<uint8_t> &surrounding_count)
     };
 
     const auto update_xy = [&g, &surrounding_count](size_t c, size_t r) {
-        if (g.chars[r * g.w + c] != '@') {
+        if (g.at(c, r) != '@') {
             return;
         }
 
         for (const auto &[col, row] : ring) {
             const size_t newc = c + col;
             const size_t newr = r + row;
-            if (newc < g.w && newr < g.h) {
-                surrounding_count[g.w * newr + newc]++;
+            if (newc < g.width() && newr < g.height()) {
+                surrounding_count[g.idx(newc, newr)]++;
             }
         }
     };
@@ -85,8 +99,8 @@ static void find_rolls_free(const Grid &g, vector<uint8_t> &surrounding_count)
         static_assert(sizeof(StrideInt) == STRIDE);
         StrideInt val;
 
-        const size_t idx = r * g.w + c;
-        std::memcpy(&val, &g.chars[idx], sizeof(val));
+        const size_t idx = g.idx(c, r);
+        std::memcpy(&val, &g.m_grid[idx], sizeof(val));
         static constexpr const StrideInt mask = ~StrideInt(0) / 255 * '@'; // every byte has @
         static constexpr const StrideInt ones = ~StrideInt(0) / 255 * 0x01;   // every byte has 0x01
         static constexpr const StrideInt topb = ~StrideInt(0) / 255 * 0x80;   // every byte has 0x80
@@ -111,7 +125,7 @@ static void find_rolls_free(const Grid &g, vector<uint8_t> &surrounding_count)
 
         // update row above
         for (int j = 0; j < STRIDE + 2; j++) {
-            surrounding_count[idx - g.w - 1 + j] += conv_out[j];
+            surrounding_count[idx - g.stride() - 1 + j] += conv_out[j];
         }
 
         // update this row (left and right)
@@ -122,7 +136,7 @@ static void find_rolls_free(const Grid &g, vector<uint8_t> &surrounding_count)
 
         // update row below
         for (int j = 0; j < STRIDE + 2; j++) {
-            surrounding_count[idx + g.w - 1 + j] += conv_out[j];
+            surrounding_count[idx + g.stride() - 1 + j] += conv_out[j];
         }
     };
 
@@ -130,11 +144,11 @@ static void find_rolls_free(const Grid &g, vector<uint8_t> &surrounding_count)
     // methods
 
     // first row
-    for (size_t c = 0; c < g.w; c++) {
+    for (size_t c = 0; c < g.width(); c++) {
         update_xy(c, 0);
     }
 
-    for (size_t r = 1; r < (g.h - 1); r++) {
+    for (size_t r = 1; r < (g.height() - 1); r++) {
         update_xy(0, r);
         size_t c = 1;
 
@@ -143,21 +157,21 @@ static void find_rolls_free(const Grid &g, vector<uint8_t> &surrounding_count)
             update_xy(c, r);
         }
 
-        // c + STRIDE goes 1 too far which is why we don't need to check < g.w
+        // c + STRIDE goes 1 too far which is why we don't need to check < g.width()
         // - 1 for the last column
-        while (c + STRIDE < g.w) {
+        while (c + STRIDE < g.width()) {
             swar_at(c, r);
             c += STRIDE;
         }
 
-        for ( ; c < g.w; c++) {
+        for ( ; c < g.width(); c++) {
             update_xy(c, r);
         }
     }
 
     // last row
-    for (size_t c = 0; c < g.w; c++) {
-        update_xy(c, g.h - 1);
+    for (size_t c = 0; c < g.width(); c++) {
+        update_xy(c, g.height() - 1);
     }
 
     (void) dump_grid;
@@ -167,11 +181,67 @@ static void find_rolls_free(const Grid &g, vector<uint8_t> &surrounding_count)
 static size_t remove_free_rolls(Grid &g, const vector<uint8_t> &surrounding_count)
 {
     size_t sum = 0;
-    for (size_t i = 0; i < g.chars.size(); i++) {
-        if (g.chars[i] == '@' && surrounding_count[i] < 4) {
-            g.chars[i] = 'x';
+    g.for_each('@', [&g, &surrounding_count, &sum](size_t c, size_t r) {
+        const size_t idx = g.idx(c, r);
+        if (surrounding_count[idx] < 4) {
+            g.m_grid[idx] = 'x';
             sum++;
         }
+    });
+
+    return sum;
+}
+
+static inline void full_add(uint64_t a, uint64_t b, uint64_t c, uint64_t &sum, uint64_t &carry)
+{
+    sum   = a ^ b ^ c;
+    carry = (a & b) | (c & (a ^ b));
+}
+
+// Same as find_rolls_free + remove_free_rolls but on the packed grid, 64 cells
+// at a time. The 8 neighbor bits for each cell are added together bit-sliced
+// (one adder per bit position of the count), and a roll is free if the 4s and
+// 8s bits of its count are both clear.
+static size_t remove_free_rolls_packed(PackedGrid &g, vector<uint64_t> &free_rolls)
+{
+    const size_t n = g.words_per_row();
+    const vector<uint64_t> empty_row(n, 0);
+
+    free_rolls.assign(n * g.height(), 0);
+
+    for (size_t r = 0; r < g.height(); r++) {
+        const auto above = r > 0              ? g.row_words(r - 1) : std::span(empty_row);
+        const auto cur   = g.row_words(r);
+        const auto below = r + 1 < g.height() ? g.row_words(r + 1) : std::span(empty_row);
+
+        for (size_t w = 0; w < n; w++) {
+            // bit i of west() is the cell to the west of cell i, etc.
+            const auto west = [w](const auto &row) {
+                return (row[w] << 1) | (w > 0 ? row[w - 1] >> 63 : 0);
+            };
+            const auto east = [w, n](const auto &row) {
+                return (row[w] >> 1) | (w + 1 < n ? row[w + 1] << 63 : 0);
+            };
+
+            uint64_t s1, c1, s2, c2, s3, c3, ones, c4;
+            full_add(west(above), above[w], east(above), s1, c1);
+            full_add(west(cur), east(cur), west(below), s2, c2);
+            full_add(below[w], east(below), 0, s3, c3);
+            full_add(s1, s2, s3, ones, c4);
+
+            // c1..c4 each count for 2, and any two of them set makes a 4
+            uint64_t twos, fours_a, fours_b;
+            full_add(c1, c2, c3, twos, fours_a);
+            fours_b = twos & c4;
+
+            free_rolls[r * n + w] = cur[w] & ~(fours_a | fours_b);
+        }
+    }
+
+    size_t sum = 0;
+    for (size_t i = 0; i < free_rolls.size(); i++) {
+        g.m_words[i] &= ~free_rolls[i];
+        sum += std::popcount(free_rolls[i]);
     }
 
     return sum;
@@ -187,17 +257,29 @@ int main(int argc, char *argv[])
     string fname(argv[1]);
 
     try {
-        Grid g = get_input_lines(fname);
-        cout << "Grid size: " << g.w << "," << g.h << "\n";
-
-        vector<uint8_t> surrounding_count;
         size_t sum;
         size_t total_sum = 0;
 
-        find_rolls_free(g, surrounding_count);
-        while ((sum = remove_free_rolls(g, surrounding_count)) > 0) {
-            total_sum += sum;
+        if constexpr (use_packed_grid) {
+            PackedGrid g = get_input_packed(fname);
+            cout << "Grid size: " << g.width() << "," << g.height() << "\n";
+
+            vector<uint64_t> free_rolls;
+            while ((sum = remove_free_rolls_packed(g, free_rolls)) > 0) {
+                total_sum += sum;
+            }
+        }
+        else {
+            Grid g = get_input_lines(fname);
+            cout << "Grid size: " << g.width() << "," << g.height() << "\n";
+
+            vector<uint8_t> surrounding_count;
+
             find_rolls_free(g, surrounding_count);
+            while ((sum = remove_free_rolls(g, surrounding_count)) > 0) {
+                total_sum += sum;
+                find_rolls_free(g, surrounding_count);
+            }
         }
 
         cout << total_sum << "\n";
@@ -9,6 +9,8 @@
 #include <utility>
 #include <vector>
 
+#include "grid.h"
+
 using std::array;
 using std::cout;
 using std::cerr;
@@ -23,15 +25,8 @@ using std::size_t;
 namespace stdr = std::ranges;
 namespace stdv = std::views;
 
-struct Grid
-{
-    string chars;
-    size_t w;
-    size_t h;
-};
-
-// In case we SIMD later
-static constexpr const size_t STRIDE = 8;
+// rows are padded out to a multiple of 8 with '.', in case we SIMD later
+using Grid = grid<size_t, 0, 0, row_padding<8, '.'>>;
 
 static Grid get_input_lines(const string &fname)
 {
@@ -44,13 +39,7 @@ static Grid get_input_lines(const string &fname)
     string buf;
 
     while (std::getline(in_f, buf)) {
-        const size_t des_sz = STRIDE * ((buf.size() + (STRIDE - 1)) / STRIDE);
-        buf.resize(des_sz, '.');
-
-        out.chars.append(buf);
-
-        out.h++;
-        out.w = buf.size();
+        out.add_line(buf);
     }
 
     return out;
@@ -67,25 +56,23 @@ int main(int argc, char *argv[])
 
     try {
         Grid g = get_input_lines(fname);
-        cout << "Grid size: " << g.w << "," << g.h << "\n";
+        cout << "Grid size: " << g.width() << "," << g.height() << "\n";
 
         unsigned total_sum = 0;
-        string tachyons(g.w, ' ');
+        string tachyons(g.stride(), ' ');
 
-        for (size_t i = 0; i < g.h; i++) {
-            const string_view line(&g.chars[g.w * i], g.w);
+        // look for start
+        const auto start_pos = g.find('S');
+        if (!start_pos) {
+            throw std::runtime_error("No start position");
+        }
 
-            // look for start
-            const auto start_pos = line.find('S');
-            if (start_pos < line.size()) {
-                tachyons[start_pos] = '|';
-                continue;
-            }
+        const auto [start_col, start_row] = *start_pos;
+        tachyons[start_col] = '|';
 
+        for (size_t i = start_row + 1; i < g.height(); i++) {
             // look for splitters
-            auto &&splitters = line | stdv::enumerate
-                | stdv::filter([](const auto &tpl) { return get<1>(tpl) == '^'; });
-            for (const auto [idx, ch] : splitters) {
+            g.for_each_in_row(i, '^', [&tachyons, &total_sum](size_t idx) {
 //              cout << "line " << i << " has a splitter at " << idx << "\n";
                 if (tachyons[idx] == '|') {
                     tachyons[idx - 1] = '|';
@@ -93,7 +80,7 @@ int main(int argc, char *argv[])
                     tachyons[idx + 1] = '|';
                     total_sum++;
                 }
-            }
+            });
         }
 
         cout << total_sum << "\n";
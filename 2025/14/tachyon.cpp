@@ -10,6 +10,8 @@
 #include <utility>
 #include <vector>
 
+#include "grid.h"
+
 using std::array;
 using std::cout;
 using std::cerr;
@@ -26,12 +28,7 @@ namespace stdv = std::views;
 
 using Int = std::uint64_t;
 
-struct Grid
-{
-    string chars;
-    size_t w = 0;
-    size_t h = 0;
-};
+using Grid = grid<size_t>;
 
 static string inline file_slurp(const string &fname)
 {
@@ -51,9 +48,14 @@ static string inline file_slurp(const string &fname)
 
 static Grid get_input_lines(const string &fname)
 {
-    Grid out { file_slurp(fname) };
-    out.w = out.chars.find('\n');
-    out.h = stdr::count(out.chars, '\n');
+    const string chars = file_slurp(fname);
+    Grid out;
+
+    for (const auto &subr : stdv::split(chars, '\n')) {
+        if (!subr.empty()) {
+            out.add_line(string_view(subr.begin(), subr.end()));
+        }
+    }
 
     return out;
 }
@@ -74,44 +76,21 @@ int main(int argc, char *argv[])
         const auto start = steady_clock::now();
 
         Grid g = get_input_lines(fname);
-        cout << "Grid size: " << g.w << "," << g.h << "\n";
+        cout << "Grid size: " << g.width() << "," << g.height() << "\n";
 
-        vector<Int> tachyons(g.w, 0); // number of beams through a cell
+        vector<Int> tachyons(g.width(), 0); // number of beams through a cell
         unsigned num_splits = 0;
 
-        // this is a wee bit clunky but I don't want to have a boolean check
-        // while we're iterating through the meat of the range, so break out
-        // the start stuff into a manually-advanced loop and then do a normal
-        // range-based loop afterwards.
-        auto lines = stdv::split(g.chars, '\n')
-            | stdv::transform([](const auto &subr) {
-                // each line will start as a subrange that must be manually
-                // converted to a std::string_view.
-                return string_view(subr.begin(), subr.end());
-            });
-
-        auto it = lines.begin();
-        while (it != lines.end()) {
-            const string_view line(*it);
-            ++it;
-
-            const size_t pos = line.find('S');
-            if (pos < line.size()) {
-                tachyons[pos] = 1;
-                break;
-            }
+        const auto start_pos = g.find('S');
+        if (!start_pos) {
+            throw std::runtime_error("No start position");
         }
 
-        const auto remainder = stdr::subrange(it, stdr::end(lines));
+        const auto [start_col, start_row] = *start_pos;
+        tachyons[start_col] = 1;
 
-        for (const string_view line : remainder) {
-            auto splitters = line
-                | stdv::enumerate
-                | stdv::filter([](const auto &tpl) { return get<1>(tpl) == '^'; })
-                | stdv::keys // get the first element which is the index
-                ;
-
-            for (const size_t idx : splitters) {
+        for (size_t i = start_row + 1; i < g.height(); i++) {
+            g.for_each_in_row(i, '^', [&tachyons, &num_splits](size_t idx) {
                 const Int old = tachyons[idx];
                 tachyons[idx - 1] += old;
                 tachyons[idx + 1] += old;
@@ -119,7 +98,7 @@ int main(int argc, char *argv[])
                 if (old > 0) {
                     num_splits++;
                 }
-            }
+            });
         }
 
         const Int total_sum = stdr::fold_left(tachyons, Int(0), std::plus{});
@@ -0,0 +1,49 @@
+// AoC - heap allocation counter
+//
+// Replaces the global operator new/delete so that a program can see how many
+// heap allocations a piece of code makes, e.g. to check that a search loop does
+// none per visited node. The replacements are ordinary (non-inline) functions,
+// so include this from exactly one translation unit; each puzzle is one .cpp.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+inline std::atomic<std::uint64_t> g_num_allocs { 0 };
+
+// allocations made so far
+inline std::uint64_t alloc_count() { return g_num_allocs.load(std::memory_order_relaxed); }
+
+// All noinline: once inlined gcc can see malloc/free on either side of a
+// new/delete pair and warns about mismatched allocation functions.
+
+//{{{
+[[gnu::noinline]] void *operator new(std::size_t n)
+{
+    g_num_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void *operator new(std::size_t n, std::align_val_t al)
+{
+    g_num_allocs.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t a = static_cast<std::size_t>(al);
+    if (void *p = std::aligned_alloc(a, ((n ? n : 1) + a - 1) / a * a)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void *p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+//}}}
+
+// vim: fdm=marker:
@@ -0,0 +1,182 @@
+// AoC - bit-parallel breadth first search
+//
+// For grids where every move costs one step. The set of cells reached after
+// exactly t steps is kept as one bit per cell, and one step of every path at
+// once is
+//
+//     next = (f << 1 | f >> 1 | up | down) & open
+//
+// done 64 cells per word. The word loop has no branches, so the compiler
+// vectorizes it and whole rows go through per instruction.
+//
+// Layout: each row is its words followed by one guard word, and there is a
+// guard row above and below the grid. Guards are never open, so they stay
+// zero and the kernel can read one word (or one row) past any cell without
+// edge checks.
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "grid.h"
+
+class bit_frontier
+{
+    public:
+    using word_t      = uint64_t;
+    using container_t = std::vector<word_t, aligned_allocator<word_t>>;
+
+    // every cell other than wall is open. Grid is anything with grid_scans.
+    template <class Grid>
+    explicit bit_frontier(const Grid &g, char wall = '#');
+
+    // restarts the search from a single cell
+    void seed(std::size_t col, std::size_t row);
+
+    void step();
+
+    // Steps until max_steps, returns the number of cells reached at each
+    // step count 0..max_steps. Once the reached set repeats every second
+    // step the rest of the counts are filled in without stepping, and the
+    // current set is left as the one for max_steps either way.
+    std::vector<std::size_t> run(int max_steps);
+
+    // Same, but stops as soon as the set repeats so the counts only go up
+    // to there. Counts for later steps are the last two, alternating.
+    std::vector<std::size_t> run_until_settled(int max_steps);
+    bool settled() const { return m_settled; }
+
+    int steps() const { return m_steps; }
+    std::size_t count() const;
+    bool contains(std::size_t col, std::size_t row) const {
+        return (m_cur[word_idx(col, row)] >> (col % 64)) & 1;
+    }
+
+    std::size_t width() const { return m_width; }
+    std::size_t height() const { return m_height; }
+
+    private:
+    std::size_t word_idx(std::size_t col, std::size_t row) const {
+        return (row + 1) * m_stride + col / 64;
+    }
+
+    std::size_t m_width, m_height;
+    std::size_t m_row_words;  // words holding cells in each row
+    std::size_t m_stride;     // m_row_words + the guard word
+
+    container_t m_open, m_cur, m_next;
+
+    // rows that can hold a reached cell, grows by one each way per step
+    std::size_t m_row_lo = 0, m_row_hi = 0;
+    int m_steps = 0;
+    bool m_settled = false;
+};
+
+//{{{
+template <class Grid>
+bit_frontier::bit_frontier(const Grid &g, const char wall)
+    : m_width(g.width())
+    , m_height(g.height())
+    , m_row_words((m_width + 63) / 64)
+    , m_stride(m_row_words + 1)
+{
+    const std::size_t total = (m_height + 2) * m_stride;
+    m_open.assign(total, 0);
+    m_cur.assign(total, 0);
+    m_next.assign(total, 0);
+
+    const word_t tail = (m_width % 64) ? (word_t(1) << (m_width % 64)) - 1 : ~word_t(0);
+    for (std::size_t r = 0; r < m_height; r++) {
+        const std::span<word_t> row(&m_open[word_idx(0, r)], m_row_words);
+        g.row_mask(r, wall, row);
+        for (word_t &w : row) {
+            w = ~w;
+        }
+        row.back() &= tail;
+    }
+}
+
+inline void bit_frontier::seed(const std::size_t col, const std::size_t row)
+{
+    std::fill(m_cur.begin(), m_cur.end(), 0);
+    std::fill(m_next.begin(), m_next.end(), 0);
+    m_cur[word_idx(col, row)] = word_t(1) << (col % 64);
+    m_row_lo = m_row_hi = row;
+    m_steps = 0;
+    m_settled = false;
+}
+
+inline void bit_frontier::step()
+{
+    // rows outside [lo, hi] are zero in both buffers, so only the band
+    // around the current set needs computing
+    m_row_lo = m_row_lo ? m_row_lo - 1 : 0;
+    m_row_hi = std::min(m_row_hi + 1, m_height - 1);
+
+    const std::ptrdiff_t S = m_stride;
+    const word_t *__restrict f = m_cur.data();
+    const word_t *__restrict open = m_open.data();
+    word_t *__restrict out = m_next.data();
+
+    const std::size_t first = (m_row_lo + 1) * m_stride;
+    const std::size_t last = (m_row_hi + 2) * m_stride;
+    for (std::size_t i = first; i < last; i++) {
+        const word_t horiz = (f[i] << 1) | (f[i - 1] >> 63) | (f[i] >> 1) | (f[i + 1] << 63);
+        out[i] = (horiz | f[i - S] | f[i + S]) & open[i];
+    }
+
+    std::swap(m_cur, m_next);
+    m_steps++;
+}
+
+inline std::size_t bit_frontier::count() const
+{
+    std::size_t total = 0;
+    for (std::size_t i = (m_row_lo + 1) * m_stride; i < (m_row_hi + 2) * m_stride; i++) {
+        total += std::popcount(m_cur[i]);
+    }
+    return total;
+}
+
+inline std::vector<std::size_t> bit_frontier::run_until_settled(const int max_steps)
+{
+    std::vector<std::size_t> counts;
+    counts.push_back(count());
+
+    // Every cell reached after t - 2 steps is reached again after t by
+    // stepping away and back, so equal counts mean equal sets and from
+    // then on the sets just alternate.
+    while (m_steps < max_steps && !m_settled) {
+        step();
+        counts.push_back(count());
+        m_settled = m_steps >= 2 && counts[m_steps] == counts[m_steps - 2];
+    }
+
+    return counts;
+}
+
+inline std::vector<std::size_t> bit_frontier::run(const int max_steps)
+{
+    std::vector<std::size_t> counts = run_until_settled(max_steps);
+    counts.reserve(max_steps + 1);
+
+    if (m_settled) {
+        for (int t = m_steps + 1; t <= max_steps; t++) {
+            counts.push_back(counts[t - 2]);
+        }
+        if ((max_steps - m_steps) % 2) {
+            std::swap(m_cur, m_next); // the other parity's set
+        }
+        m_steps = max_steps;
+    }
+
+    return counts;
+}
+//}}}
+
+// vim: fdm=marker:
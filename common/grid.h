@@ -0,0 +1,407 @@
+// AoC - common grid support
+//
+// Shared by the 2023 and 2025 grid puzzles (add -I../../common to the build).
+//
+// coordinate system:
+// leftmost character is 0, increases by 1 each character going to the right
+// topmost character is 0, increases by 1 each additional line down
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512BW__)
+#include <immintrin.h>
+#endif
+
+enum class Dir { west, east, north, south };
+
+// Neighbour offsets as (dx, dy), in constant tables so that searches can walk
+// them as spans without building anything per visit.
+namespace steps {
+using offset = std::pair<int, int>;
+
+// one step in each Dir, indexed by Dir
+inline constexpr std::array<offset, 4> one {{ { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } }};
+
+// every cell two moves away, including going away and back
+inline constexpr std::array<offset, 9> two {{
+    { -2, 0 }, { 2, 0 }, { 0, 2 }, { 0, -2 },
+    { -1, 1 }, { -1, -1 }, { 1, 1 }, { 1, -1 },
+    { 0, 0 },
+}};
+
+constexpr offset of(const Dir dir) { return one[static_cast<int>(dir)]; }
+
+// change in a grid's linear index for a step
+template <class G>
+std::ptrdiff_t index_delta(const G &g, const offset o) {
+    return std::ptrdiff_t(o.second) * std::ptrdiff_t(g.stride()) + o.first;
+}
+} // namespace steps
+
+// stands in for a runtime int width/height when the size is known at compile
+// time, so that the optimizer can fold it into index math
+template <int N>
+struct fixed_extent
+{
+    constexpr fixed_extent(int) { }
+    constexpr operator int() const { return N; }
+};
+
+template <int N>
+using extent_t = std::conditional_t<N != 0, fixed_extent<N>, int>;
+
+// Row storage is always allocated on a cache line boundary so that the scans
+// below start aligned.
+template <class T, std::size_t Align = 64>
+struct aligned_allocator
+{
+    using value_type = T;
+
+    template <class U>
+    struct rebind { using other = aligned_allocator<U, Align>; };
+
+    aligned_allocator() = default;
+    template <class U>
+    constexpr aligned_allocator(const aligned_allocator<U, Align> &) noexcept { }
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+
+    void deallocate(T *p, std::size_t) noexcept {
+        ::operator delete(p, std::align_val_t(Align));
+    }
+
+    template <class U>
+    bool operator==(const aligned_allocator<U, Align> &) const noexcept { return true; }
+};
+
+// Padding policies. Each row is padded with 'fill' out to a multiple of
+// 'align' characters. no_padding keeps stride() == width().
+struct no_padding
+{
+    static constexpr std::size_t align = 1;
+    static constexpr char fill = '\0';
+};
+
+template <std::size_t Align, char Fill = '.'>
+struct row_padding
+{
+    static_assert(Align > 0);
+    static constexpr std::size_t align = Align;
+    static constexpr char fill = Fill;
+};
+
+// Vectorized byte scans. Everything is built on match64, which turns 64
+// bytes into a bitmask of which ones equal c.
+namespace scan {
+
+inline uint64_t match64(const char *p, char c)
+{
+#if defined(__AVX512BW__)
+    const __m512i v = _mm512_loadu_si512(p);
+    return _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(c));
+#elif defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi8(c);
+    const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+    const uint32_t mlo = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle));
+    const uint32_t mhi = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle));
+    return (uint64_t(mhi) << 32) | mlo;
+#else
+    uint64_t m = 0;
+    for (int i = 0; i < 64; i++) {
+        m |= uint64_t(p[i] == c) << i;
+    }
+    return m;
+#endif
+}
+
+// same as match64 but only looks at the first n (< 64) bytes
+inline uint64_t match_partial(const char *p, std::size_t n, char c)
+{
+    uint64_t m = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        m |= uint64_t(p[i] == c) << i;
+    }
+    return m;
+}
+
+// number of bytes in [p, p + n) equal to c
+inline std::size_t count(const char *p, std::size_t n, char c)
+{
+    std::size_t total = 0, i = 0;
+    for (; i + 64 <= n; i += 64) {
+        total += std::popcount(match64(p + i, c));
+    }
+    return total + std::popcount(match_partial(p + i, n - i, c));
+}
+
+// calls fn(offset) for each byte in [p, p + n) equal to c, in order
+template <class Fn>
+inline void for_each_match(const char *p, std::size_t n, char c, Fn &&fn)
+{
+    for (std::size_t i = 0; i < n; i += 64) {
+        uint64_t m = (i + 64 <= n) ? match64(p + i, c) : match_partial(p + i, n - i, c);
+        while (m) {
+            fn(i + std::countr_zero(m));
+            m &= m - 1;
+        }
+    }
+}
+
+// fills out with one bit per byte of [p, p + n), set where the byte equals c.
+// out must hold at least (n + 63) / 64 words.
+inline void match_mask(const char *p, std::size_t n, char c, std::span<uint64_t> out)
+{
+    std::size_t i = 0, w = 0;
+    for (; i + 64 <= n; i += 64) {
+        out[w++] = match64(p + i, c);
+    }
+    if (i < n) {
+        out[w] = match_partial(p + i, n - i, c);
+    }
+}
+
+} // namespace scan
+
+// Vectorized cell scans shared by every kind of grid, these never look at
+// padding. Derived needs pos_t, data(), width(), height() and stride().
+template <class Derived>
+struct grid_scans
+{
+    std::string_view row(const auto row) const {
+        return std::string_view(d().data() + std::size_t(row) * d().stride(), d().width());
+    }
+
+    std::size_t count(const char c) const {
+        if (d().stride() == std::size_t(d().width())) {
+            return scan::count(d().data(), d().stride() * d().height(), c);
+        }
+
+        std::size_t total = 0;
+        for (std::size_t r = 0; r < std::size_t(d().height()); r++) {
+            total += scan::count(row(r).data(), d().width(), c);
+        }
+        return total;
+    }
+
+    // col, row of the first c, in reading order
+    auto find(const char c) const {
+        using pos_t = typename Derived::pos_t;
+        for (pos_t r = 0; r < d().height(); r++) {
+            const auto rv = row(r);
+            for (std::size_t i = 0; i < rv.size(); i += 64) {
+                const uint64_t m = (i + 64 <= rv.size())
+                    ? scan::match64(&rv[i], c)
+                    : scan::match_partial(&rv[i], rv.size() - i, c);
+                if (m) {
+                    return std::optional(std::make_pair(pos_t(i + std::countr_zero(m)), r));
+                }
+            }
+        }
+
+        return std::optional<std::pair<pos_t, pos_t>>();
+    }
+
+    // fn(col, row) for each c
+    template <class Fn>
+    void for_each(const char c, Fn &&fn) const {
+        using pos_t = typename Derived::pos_t;
+        for (pos_t r = 0; r < d().height(); r++) {
+            for_each_in_row(r, c, [&fn, r](pos_t col) { fn(col, r); });
+        }
+    }
+
+    // fn(col) for each c in the row
+    template <class Fn>
+    void for_each_in_row(const auto row, const char c, Fn &&fn) const {
+        using pos_t = typename Derived::pos_t;
+        scan::for_each_match(this->row(row).data(), d().width(), c,
+                [&fn](std::size_t col) { fn(pos_t(col)); });
+    }
+
+    std::size_t mask_words() const { return (std::size_t(d().width()) + 63) / 64; }
+
+    // bit per cell of the row, set where it is c. out needs mask_words() words
+    void row_mask(const auto row, const char c, std::span<uint64_t> out) const {
+        scan::match_mask(this->row(row).data(), d().width(), c, out);
+    }
+
+    private:
+    const Derived &d() const { return static_cast<const Derived &>(*this); }
+};
+
+// FixedW/FixedH of 0 means the size is only known at runtime. Otherwise the
+// grid is specialized for that exact size (see dispatch_grid).
+template <std::integral T, T FixedW = 0, T FixedH = 0, class Padding = no_padding>
+struct grid : grid_scans<grid<T, FixedW, FixedH, Padding>>
+{
+    using container_t = std::vector<char, aligned_allocator<char>>;
+    using pos_t       = T;
+    using index_t     = std::size_t;
+    using bounds_t    = std::tuple<index_t, index_t, std::ptrdiff_t>; // start, end, step
+    using padding_t   = Padding;
+
+    static constexpr pos_t fixed_width  = FixedW;
+    static constexpr pos_t fixed_height = FixedH;
+
+    template <T W, T H> using with_extents = grid<T, W, H, Padding>;
+
+    grid() = default;
+    template <T W, T H>
+    explicit grid(const grid<T, W, H, Padding> &g)
+        : m_grid(g.m_grid), m_width(g.m_width), m_height(g.m_height)
+    {
+    }
+
+    void add_line(std::string_view line);
+
+    bounds_t steps_for_dir(const pos_t pos, const Dir dir) const;
+    container_t extract_line(const pos_t pos, const Dir dir) const;
+    void set_line(const container_t &line, const pos_t pos, const Dir dir);
+    char at(const pos_t col, const pos_t row) const { return m_grid[idx(col, row)]; }
+    char &at(const pos_t col, const pos_t row) { return m_grid[idx(col, row)]; }
+    index_t idx(const pos_t col, const pos_t row) const { return index_t(row) * stride() + col; }
+
+    pos_t height() const {
+        if constexpr (FixedH != 0) { return FixedH; }
+        return m_height;
+    }
+    pos_t width() const {
+        if constexpr (FixedW != 0) { return FixedW; }
+        return m_width;
+    }
+    // distance between the start of each row, including padding
+    index_t stride() const {
+        constexpr auto A = Padding::align;
+        return (index_t(width()) + A - 1) / A * A;
+    }
+    const char *data() const { return m_grid.data(); }
+    std::string_view view() const { return std::string_view(m_grid.data(), stride() * height()); }
+
+    void dump_grid() const;
+
+    public:
+    container_t m_grid;
+    pos_t m_width = 0, m_height = 0;
+};
+
+//{{{
+template <std::integral T, T FixedW, T FixedH, class Padding>
+void grid<T, FixedW, FixedH, Padding>::add_line(std::string_view line)
+{
+    if(!m_width) { m_width = line.size(); }
+    line = line.substr(0, width()); // anything past the first row's width is dropped
+    std::copy(line.begin(), line.end(), std::back_inserter(m_grid));
+    m_grid.resize(m_grid.size() + (stride() - line.size()), Padding::fill);
+    m_height++;
+}
+
+template <std::integral T, T FixedW, T FixedH, class Padding>
+void grid<T, FixedW, FixedH, Padding>::dump_grid() const
+{
+    using std::cout;
+    cout << "grid: " << width() << "x" << height() << "\n";
+    for(pos_t r = 0; r < height(); r++) {
+        cout << this->row(r) << "\n";
+    }
+}
+
+// common code for iterating across a column or row
+template <std::integral T, T FixedW, T FixedH, class Padding>
+auto grid<T, FixedW, FixedH, Padding>::steps_for_dir(const pos_t pos, const Dir dir) const
+-> bounds_t
+{
+    index_t start = 0, end = 0;
+    std::ptrdiff_t step = 1; // can be negative
+
+    // we will iterate up to AND INCLUDING the end
+    if (dir == Dir::east || dir == Dir::west) {
+        start = idx(0, pos);
+        end = idx(width() - 1, pos);
+    } else {
+        start = idx(pos, 0);
+        end = idx(pos, height() - 1);
+        step = stride();
+    }
+
+    if (dir == Dir::north || dir == Dir::west) {
+        step *= -1;
+        std::swap(start, end);
+    }
+
+    end += step; // so we can abort as soon as we see this
+
+    return std::make_tuple(start, end, step);
+}
+
+template <std::integral T, T FixedW, T FixedH, class Padding>
+auto grid<T, FixedW, FixedH, Padding>::extract_line(const pos_t pos, const Dir dir) const
+-> container_t
+{
+    container_t result;
+    const auto &[start, end, step] = steps_for_dir(pos, dir);
+
+    for (index_t i = start; i != end; i += step) {
+        result.push_back(m_grid[i]);
+    }
+
+    return result;
+}
+
+template <std::integral T, T FixedW, T FixedH, class Padding>
+void grid<T, FixedW, FixedH, Padding>::set_line(const container_t &line, const pos_t pos, const Dir dir)
+{
+    const auto &[start, end, step] = steps_for_dir(pos, dir);
+
+    auto it = line.begin();
+    for (index_t i = start; i != end; i += step) {
+        m_grid[i] = *it++;
+    }
+}
+//}}}
+
+// Calls fn with either a fixed-size version of g (if its size is one of Sizes)
+// or g itself. Sizes is a std::array of grid_size. G is any grid type with a
+// with_extents<W, H> alias that can be constructed from g.
+struct grid_size { std::size_t w, h; };
+
+template <auto Sizes, std::size_t I = 0, class G, class Fn>
+    requires (G::fixed_width == 0 && G::fixed_height == 0)
+auto dispatch_grid(const G &g, Fn &&fn)
+{
+    using T = typename G::pos_t;
+
+    if constexpr (I == Sizes.size()) {
+        return fn(g);
+    } else {
+        constexpr grid_size sz = Sizes[I];
+        if (std::size_t(g.width()) == sz.w && std::size_t(g.height()) == sz.h) {
+            const typename G::template with_extents<T(sz.w), T(sz.h)> fixed_g(g);
+            return fn(fixed_g);
+        }
+
+        return dispatch_grid<Sizes, I + 1>(g, std::forward<Fn>(fn));
+    }
+}
+
+// vim: fdm=marker:
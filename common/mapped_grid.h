@@ -0,0 +1,155 @@
+// AoC - memory mapped grid
+//
+// Maps the input file read-only and uses it as the grid in place: each row is
+// followed by its newline, so the row stride is width + 1 and nothing is
+// copied. The grid is immutable, puzzles that edit cells still use grid.
+//
+// The file must have rows of equal width, the last newline is optional.
+
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "grid.h"
+
+// read-only mapping of a whole file, is_open() is false if that failed
+class file_mapping
+{
+    public:
+    explicit file_mapping(const std::string &filename);
+    ~file_mapping();
+
+    file_mapping(const file_mapping &) = delete;
+    file_mapping &operator=(const file_mapping &) = delete;
+
+    bool is_open() const { return m_open; }
+    const char *data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+    private:
+    static constexpr std::size_t populate_limit = std::size_t(64) << 20;
+
+    const char *m_data = nullptr;
+    std::size_t m_size = 0;
+    bool m_open = false;
+};
+
+//{{{
+inline file_mapping::file_mapping(const std::string &filename)
+{
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0) {
+        m_size = st.st_size;
+        if (m_size == 0) {
+            m_open = true;
+        } else {
+            // puzzle sized files get read in up front, huge ones are paged in
+            // on demand so that they don't have to fit in memory
+            const int populate = (m_size <= populate_limit) ? MAP_POPULATE : 0;
+            void *p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE | populate, fd, 0);
+            if (p != MAP_FAILED) {
+                m_data = static_cast<const char *>(p);
+                m_open = true;
+            }
+        }
+    }
+
+    ::close(fd);
+}
+
+inline file_mapping::~file_mapping()
+{
+    if (m_data) {
+        ::munmap(const_cast<char *>(m_data), m_size);
+    }
+}
+//}}}
+
+// Copies share the mapping, so passing one around (or dispatch_grid making a
+// fixed-size version of it) is cheap.
+template <std::integral T, T FixedW = 0, T FixedH = 0>
+struct mapped_grid : grid_scans<mapped_grid<T, FixedW, FixedH>>
+{
+    using pos_t     = T;
+    using index_t   = std::size_t;
+    using padding_t = no_padding;
+
+    static constexpr pos_t fixed_width  = FixedW;
+    static constexpr pos_t fixed_height = FixedH;
+
+    template <T W, T H> using with_extents = mapped_grid<T, W, H>;
+
+    mapped_grid() = default;
+    explicit mapped_grid(const std::string &filename);
+    template <T W, T H>
+    explicit mapped_grid(const mapped_grid<T, W, H> &g)
+        : m_file(g.m_file), m_width(g.m_width), m_height(g.m_height)
+    {
+    }
+
+    bool is_open() const { return m_file && m_file->is_open(); }
+
+    char at(const pos_t col, const pos_t row) const { return data()[idx(col, row)]; }
+    index_t idx(const pos_t col, const pos_t row) const { return index_t(row) * stride() + col; }
+
+    pos_t height() const {
+        if constexpr (FixedH != 0) { return FixedH; }
+        return m_height;
+    }
+    pos_t width() const {
+        if constexpr (FixedW != 0) { return FixedW; }
+        return m_width;
+    }
+    // rows are separated by their newline
+    index_t stride() const { return index_t(width()) + 1; }
+    const char *data() const { return m_file->data(); }
+    std::string_view view() const { return std::string_view(data(), m_file->size()); }
+
+    void dump_grid() const;
+
+    public:
+    std::shared_ptr<const file_mapping> m_file;
+    pos_t m_width = 0, m_height = 0;
+};
+
+//{{{
+template <std::integral T, T FixedW, T FixedH>
+mapped_grid<T, FixedW, FixedH>::mapped_grid(const std::string &filename)
+    : m_file(std::make_shared<const file_mapping>(filename))
+{
+    if (!m_file->is_open() || m_file->size() == 0) {
+        return;
+    }
+
+    const std::string_view v = view();
+    m_width = v.find('\n') == std::string_view::npos ? v.size() : v.find('\n');
+    m_height = scan::count(v.data(), v.size(), '\n') + (v.back() != '\n');
+}
+
+template <std::integral T, T FixedW, T FixedH>
+void mapped_grid<T, FixedW, FixedH>::dump_grid() const
+{
+    using std::cout;
+    cout << "grid: " << width() << "x" << height() << "\n";
+    for(pos_t r = 0; r < height(); r++) {
+        cout << this->row(r) << "\n";
+    }
+}
+//}}}
+
+// vim: fdm=marker:
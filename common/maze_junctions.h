@@ -0,0 +1,160 @@
+// AoC - junctions of a maze of one cell wide corridors
+//
+// Finds the cells where corridors meet and walks the corridors between
+// them, for contracting a maze to a graph of its junctions. The open cells
+// are bits in the same guarded layout bit_frontier uses, and a cell is a
+// junction if at least three of its neighbours are open:
+//
+//     open & ((up & down & (west | east)) | (west & east & (up | down)))
+//
+// which is a few word ops for each 64 cells. Extra cells, like a maze's
+// start and end, can be made junctions too.
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "grid.h"
+
+class maze_junctions
+{
+    public:
+    using word_t = uint64_t;
+
+    // where a corridor walk ended up, and how many steps it took
+    struct corridor { int col, row, length; };
+
+    // every cell other than wall is open, and the (col, row) in extra are
+    // junctions whatever their neighbours. Grid is anything with grid_scans.
+    template <class Grid>
+    maze_junctions(const Grid &g, std::initializer_list<std::pair<int, int>> extra, char wall = '#');
+
+    bool open(int col, int row) const { return is_set(m_open, col, row); }
+    bool junction(int col, int row) const { return is_set(m_junction, col, row); }
+
+    // fn(col, row) for each junction, in reading order
+    template <class Fn>
+    void for_each_junction(Fn &&fn) const;
+
+    // Leaves junction (col, row) by dx, dy and follows the corridor, always
+    // the open way that isn't back, to the next junction. may_step(col, row,
+    // dx, dy) is asked before each step onto (col, row). Nothing if the
+    // corridor is a dead end, a step isn't allowed, or it loops back.
+    template <class MayStep>
+    std::optional<corridor> walk(int col, int row, int dx, int dy, MayStep &&may_step) const;
+    std::optional<corridor> walk(int col, int row, int dx, int dy) const {
+        return walk(col, row, dx, dy, [](int, int, int, int) { return true; });
+    }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    private:
+    std::size_t word_idx(int col, int row) const {
+        return (std::size_t(row) + 1) * m_stride + col / 64;
+    }
+    bool is_set(const std::vector<word_t> &m, int col, int row) const {
+        return col >= 0 && col < m_width && row >= 0 && row < m_height
+            && ((m[word_idx(col, row)] >> (col % 64)) & 1);
+    }
+
+    int m_width, m_height;
+    std::size_t m_row_words;  // words holding cells in each row
+    std::size_t m_stride;     // m_row_words + the guard word
+
+    std::vector<word_t> m_open, m_junction;
+};
+
+//{{{
+template <class Grid>
+maze_junctions::maze_junctions(const Grid &g, std::initializer_list<std::pair<int, int>> extra, const char wall)
+    : m_width(g.width())
+    , m_height(g.height())
+    , m_row_words((m_width + 63) / 64)
+    , m_stride(m_row_words + 1)
+{
+    const std::size_t total = (std::size_t(m_height) + 2) * m_stride;
+    m_open.assign(total, 0);
+    m_junction.assign(total, 0);
+
+    const word_t tail = (m_width % 64) ? (word_t(1) << (m_width % 64)) - 1 : ~word_t(0);
+    for (int r = 0; r < m_height; r++) {
+        const std::span<word_t> row(&m_open[word_idx(0, r)], m_row_words);
+        g.row_mask(r, wall, row);
+        for (word_t &w : row) {
+            w = ~w;
+        }
+        row.back() &= tail;
+    }
+
+    const std::size_t S = m_stride;
+    for (std::size_t i = S; i < (std::size_t(m_height) + 1) * S; i++) {
+        const word_t up = m_open[i - S], down = m_open[i + S];
+        const word_t west = (m_open[i] << 1) | (m_open[i - 1] >> 63);
+        const word_t east = (m_open[i] >> 1) | (m_open[i + 1] << 63);
+        m_junction[i] = m_open[i] & ((up & down & (west | east)) | (west & east & (up | down)));
+    }
+    for (const auto &[col, row] : extra) {
+        m_junction[word_idx(col, row)] |= word_t(1) << (col % 64);
+    }
+}
+
+template <class Fn>
+void maze_junctions::for_each_junction(Fn &&fn) const
+{
+    for (int r = 0; r < m_height; r++) {
+        const std::size_t first = word_idx(0, r);
+        for (std::size_t i = first; i < first + m_row_words; i++) {
+            for (word_t m = m_junction[i]; m; m &= m - 1) {
+                fn(int((i - first) * 64 + std::countr_zero(m)), r);
+            }
+        }
+    }
+}
+
+template <class MayStep>
+auto maze_junctions::walk(const int col, const int row, const int dx, const int dy, MayStep &&may_step) const
+-> std::optional<corridor>
+{
+    int px = col, py = row;
+    int cx = col + dx, cy = row + dy;
+    if (!open(cx, cy) || !may_step(cx, cy, dx, dy)) {
+        return std::nullopt;
+    }
+
+    int length = 1;
+    while (!junction(cx, cy)) {
+        bool moved = false;
+        for (const auto &[ndx, ndy] : steps::one) {
+            const int nx = cx + ndx, ny = cy + ndy;
+            if ((nx != px || ny != py) && open(nx, ny)) {
+                if (!may_step(nx, ny, ndx, ndy)) {
+                    return std::nullopt;
+                }
+                px = cx, py = cy;
+                cx = nx, cy = ny;
+                moved = true;
+                break;
+            }
+        }
+        if (!moved) {
+            return std::nullopt; // dead end
+        }
+        length++;
+    }
+
+    if (cx == col && cy == row) {
+        return std::nullopt;
+    }
+    return corridor { cx, cy, length };
+}
+//}}}
+
+// vim: fdm=marker:
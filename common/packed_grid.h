@@ -0,0 +1,244 @@
+// AoC - packed grid storage
+//
+// For the big generated inputs with only 2-4 distinct symbols. Each cell is
+// stored as a Bits-wide code into the grid's alphabet (1 or 2 bits), so a
+// row is a run of 64-bit words that bitwise kernels can chew on directly.
+//
+// Cells past the width in a row's last word are always code 0. Symbols
+// outside the alphabet, and alphabets too big for Bits, throw
+// std::runtime_error.
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "grid.h"
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// bit i of x moves to bit 2i of the result
+inline uint64_t spread_bits(uint32_t x)
+{
+#if defined(__BMI2__)
+    return _pdep_u64(x, 0x5555555555555555ull);
+#else
+    uint64_t v = x;
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+    v = (v | (v <<  8)) & 0x00FF00FF00FF00FFull;
+    v = (v | (v <<  4)) & 0x0F0F0F0F0F0F0F0Full;
+    v = (v | (v <<  2)) & 0x3333333333333333ull;
+    v = (v | (v <<  1)) & 0x5555555555555555ull;
+    return v;
+#endif
+}
+
+// bit 2i of x moves to bit i of the result, odd bits are ignored
+inline uint32_t compact_bits(uint64_t x)
+{
+#if defined(__BMI2__)
+    return _pext_u64(x, 0x5555555555555555ull);
+#else
+    uint64_t v = x & 0x5555555555555555ull;
+    v = (v | (v >>  1)) & 0x3333333333333333ull;
+    v = (v | (v >>  2)) & 0x0F0F0F0F0F0F0F0Full;
+    v = (v | (v >>  4)) & 0x00FF00FF00FF00FFull;
+    v = (v | (v >>  8)) & 0x0000FFFF0000FFFFull;
+    v = (v | (v >> 16)) & 0x00000000FFFFFFFFull;
+    return uint32_t(v);
+#endif
+}
+
+template <unsigned Bits>
+struct packed_grid
+{
+    static_assert(Bits == 1 || Bits == 2);
+
+    using word_t      = uint64_t;
+    using container_t = std::vector<word_t, aligned_allocator<word_t>>;
+
+    static constexpr std::size_t cells_per_word = 64 / Bits;
+
+    // alphabet[code] is the symbol for each code, at most 1 << Bits of them
+    explicit packed_grid(std::string_view alphabet)
+        : m_alphabet(alphabet)
+    {
+        if (m_alphabet.empty() || m_alphabet.size() > (std::size_t(1) << Bits)) {
+            throw std::runtime_error("packed grid alphabet needs 1 to " + std::to_string(1 << Bits) + " symbols");
+        }
+    }
+
+    void add_line(std::string_view line);
+
+    std::size_t width() const { return m_width; }
+    std::size_t height() const { return m_height; }
+    std::size_t words_per_row() const { return (m_width + cells_per_word - 1) / cells_per_word; }
+    // words needed to hold a 1-bit plane of a row, see plane()
+    std::size_t plane_words() const { return (m_width + 63) / 64; }
+
+    unsigned code(const std::size_t col, const std::size_t row) const {
+        const word_t w = m_words[row * words_per_row() + col / cells_per_word];
+        return (w >> ((col % cells_per_word) * Bits)) & cell_mask;
+    }
+    char at(const std::size_t col, const std::size_t row) const { return m_alphabet[code(col, row)]; }
+    void set(const std::size_t col, const std::size_t row, const unsigned code);
+    unsigned code_of(const char c) const;
+
+    std::span<const word_t> row_words(const std::size_t row) const {
+        return { &m_words[row * words_per_row()], words_per_row() };
+    }
+    std::span<word_t> row_words(const std::size_t row) {
+        return { &m_words[row * words_per_row()], words_per_row() };
+    }
+
+    // 1 bit per cell for a row, set where the cell is c. out needs
+    // plane_words() words.
+    void plane(const std::size_t row, const char c, std::span<word_t> out) const;
+    std::size_t count(const char c) const;
+
+    void dump_grid() const;
+
+    public:
+    container_t m_words;
+    std::string m_alphabet;
+    std::size_t m_width = 0, m_height = 0;
+
+    private:
+    static constexpr word_t cell_mask = (word_t(1) << Bits) - 1;
+    word_t tail_mask() const { // valid bits of a plane's last word
+        return (m_width % 64) ? (word_t(1) << (m_width % 64)) - 1 : ~word_t(0);
+    }
+};
+
+//{{{
+template <unsigned Bits>
+void packed_grid<Bits>::add_line(std::string_view line)
+{
+    if (!m_width) { m_width = line.size(); }
+    line = line.substr(0, m_width);
+
+    m_words.resize(m_words.size() + words_per_row(), 0);
+    word_t *out = &m_words[m_height * words_per_row()];
+
+    // 64 characters at a time, turned into a bitmask per symbol
+    for (std::size_t i = 0; i < line.size(); i += 64) {
+        const std::size_t n = std::min<std::size_t>(64, line.size() - i);
+        const auto match = [&](char c) {
+            return (n == 64) ? scan::match64(&line[i], c) : scan::match_partial(&line[i], n, c);
+        };
+
+        uint64_t seen = match(m_alphabet[0]);
+        if constexpr (Bits == 1) {
+            if (m_alphabet.size() > 1) {
+                out[i / 64] = match(m_alphabet[1]);
+                seen |= out[i / 64];
+            }
+        } else {
+            word_t lo = 0, hi = 0;
+            for (unsigned k = 1; k < m_alphabet.size(); k++) {
+                const uint64_t m = match(m_alphabet[k]);
+                lo |= spread_bits(uint32_t(m)) * k;
+                hi |= spread_bits(uint32_t(m >> 32)) * k;
+                seen |= m;
+            }
+            out[i / 32] = lo;
+            if (i / 32 + 1 < words_per_row()) {
+                out[i / 32 + 1] = hi;
+            }
+        }
+
+        const uint64_t all = (n == 64) ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+        if (seen != all) {
+            const std::size_t col = i + std::countr_zero(~seen & all);
+            throw std::runtime_error("unknown symbol '" + std::string(1, line[col]) + "' in packed grid row "
+                    + std::to_string(m_height) + " col " + std::to_string(col));
+        }
+    }
+
+    m_height++;
+}
+
+template <unsigned Bits>
+void packed_grid<Bits>::set(const std::size_t col, const std::size_t row, const unsigned code)
+{
+    word_t &w = m_words[row * words_per_row() + col / cells_per_word];
+    const unsigned shift = (col % cells_per_word) * Bits;
+    w = (w & ~(cell_mask << shift)) | (word_t(code & cell_mask) << shift);
+}
+
+template <unsigned Bits>
+unsigned packed_grid<Bits>::code_of(const char c) const
+{
+    const auto pos = m_alphabet.find(c);
+    if (pos == std::string::npos) {
+        throw std::runtime_error("unknown symbol '" + std::string(1, c) + "' for packed grid");
+    }
+    return pos;
+}
+
+template <unsigned Bits>
+void packed_grid<Bits>::plane(const std::size_t row, const char c, std::span<word_t> out) const
+{
+    const auto in = row_words(row);
+    const unsigned k = code_of(c);
+
+    if constexpr (Bits == 1) {
+        for (std::size_t i = 0; i < in.size(); i++) {
+            out[i] = k ? in[i] : ~in[i];
+        }
+    } else {
+        // a cell matches when both of its bits agree with k's
+        const word_t pattern = 0x5555555555555555ull * k;
+        for (std::size_t i = 0; i < plane_words(); i++) {
+            word_t eq[2] = { 0, 0 };
+            for (std::size_t j = 0; j < 2 && 2 * i + j < in.size(); j++) {
+                const word_t x = in[2 * i + j] ^ pattern;
+                eq[j] = ~(x | (x >> 1)) & 0x5555555555555555ull;
+            }
+            out[i] = word_t(compact_bits(eq[0])) | (word_t(compact_bits(eq[1])) << 32);
+        }
+    }
+
+    out[plane_words() - 1] &= tail_mask();
+}
+
+template <unsigned Bits>
+std::size_t packed_grid<Bits>::count(const char c) const
+{
+    std::vector<word_t> buf(plane_words());
+    std::size_t total = 0;
+
+    for (std::size_t r = 0; r < m_height; r++) {
+        plane(r, c, buf);
+        for (const word_t w : buf) {
+            total += std::popcount(w);
+        }
+    }
+
+    return total;
+}
+
+template <unsigned Bits>
+void packed_grid<Bits>::dump_grid() const
+{
+    using std::cout;
+    cout << "grid: " << m_width << "x" << m_height << " (" << Bits << " bits/cell)\n";
+    for (std::size_t row = 0; row < m_height; row++) {
+        for (std::size_t col = 0; col < m_width; col++) {
+            cout << at(col, row);
+        }
+        cout << "\n";
+    }
+}
+//}}}
+
+// vim: fdm=marker:
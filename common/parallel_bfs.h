@@ -0,0 +1,336 @@
+// AoC - direction-optimizing parallel breadth first search
+//
+// For very large grids where every move costs one step. Cells are bits in
+// the same guarded layout bit_frontier uses, and a cell's id is its bit's
+// position in the plane, so the neighbours of id are id +- 1 and id +- one
+// row of bits. Distances aren't kept, only how many cells each BFS level
+// adds, which is all the step counts need.
+//
+// Each level is expanded one of two ways:
+//  - top-down: every cell in the frontier list claims its unvisited
+//    neighbours with an atomic fetch_or on the visited bitset. Cost follows
+//    the frontier, so this wins while it is thin.
+//  - bottom-up: every unvisited open cell checks whether a neighbour is in
+//    the frontier bitset, 64 cells per word. Each thread only writes its own
+//    rows so no atomics are needed, but the cost follows the rows the search
+//    can have reached so far.
+// Like Beamer's direction-optimizing BFS, it goes bottom-up once the
+// frontier has more than 1 / bottom_up_ratio cells per word of those rows,
+// and back when it drops under 1 / top_down_ratio.
+//
+// The calling thread works as thread 0, the rest wait in a pool between
+// levels.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "grid.h"
+
+class parallel_bfs
+{
+    public:
+    using word_t      = uint64_t;
+    using container_t = std::vector<word_t, aligned_allocator<word_t>>;
+
+    // frontier cells per word of the reachable rows to switch at
+    static constexpr std::size_t bottom_up_ratio = 8;
+    static constexpr std::size_t top_down_ratio = 32;
+
+    // every cell other than wall is open. Grid is anything with grid_scans.
+    template <class Grid>
+    parallel_bfs(const Grid &g, unsigned num_threads, char wall = '#');
+    ~parallel_bfs();
+
+    parallel_bfs(const parallel_bfs &) = delete;
+    parallel_bfs &operator=(const parallel_bfs &) = delete;
+
+    // hist[d] is the number of cells at distance d from (col, row), for
+    // every d up to max_steps that has any
+    std::vector<std::size_t> distance_histogram(std::size_t col, std::size_t row, long max_steps);
+
+    // stats, levels expanded each way in the last search
+    uint_fast64_t num_top_down = 0, num_bottom_up = 0;
+
+    private:
+    enum class phase { top_down, to_bitset, bottom_up, to_list };
+
+    std::size_t word_idx(std::size_t col, std::size_t row) const {
+        return (row + 1) * m_stride + col / 64;
+    }
+    std::size_t row_of(const uint64_t id) const { return id / 64 / m_stride - 1; }
+
+    // thread t's share of [0, n)
+    std::size_t share_begin(unsigned t, std::size_t n) const { return n * t / m_num_threads; }
+    std::size_t share_end(unsigned t, std::size_t n) const { return n * (t + 1) / m_num_threads; }
+
+    void top_down(unsigned t);
+    void to_bitset(unsigned t);
+    void bottom_up(unsigned t);
+    void to_list(unsigned t);
+
+    void run_phase(unsigned t);
+    void worker(unsigned t);
+
+    std::size_t m_width, m_height;
+    std::size_t m_row_words;  // words holding cells in each row
+    std::size_t m_stride;     // m_row_words + the guard word
+    const unsigned m_num_threads;
+
+    container_t m_open, m_visited;
+    container_t m_frontier, m_next; // bottom-up only, zero otherwise
+
+    // top-down frontier, one list per thread that wrote it
+    std::vector<std::vector<uint64_t>> m_lists, m_next_lists;
+    std::vector<std::size_t> m_counts; // per thread, cells added this level
+
+    phase m_phase = phase::top_down;
+    std::size_t m_row_lo = 0, m_row_hi = 0; // rows the search can have reached
+
+    std::barrier<> m_sync;
+    bool m_stop = false;
+    std::vector<std::jthread> m_workers; // last, so that they're joined first
+};
+
+//{{{
+template <class Grid>
+parallel_bfs::parallel_bfs(const Grid &g, unsigned num_threads, const char wall)
+    : m_width(g.width())
+    , m_height(g.height())
+    , m_row_words((m_width + 63) / 64)
+    , m_stride(m_row_words + 1)
+    , m_num_threads(std::max(1u, num_threads))
+    , m_lists(m_num_threads)
+    , m_next_lists(m_num_threads)
+    , m_counts(m_num_threads)
+    , m_sync(m_num_threads)
+{
+    const std::size_t total = (m_height + 2) * m_stride;
+    m_open.assign(total, 0);
+    m_visited.assign(total, 0);
+    m_frontier.assign(total, 0);
+    m_next.assign(total, 0);
+
+    const word_t tail = (m_width % 64) ? (word_t(1) << (m_width % 64)) - 1 : ~word_t(0);
+    for (std::size_t r = 0; r < m_height; r++) {
+        const std::span<word_t> row(&m_open[word_idx(0, r)], m_row_words);
+        g.row_mask(r, wall, row);
+        for (word_t &w : row) {
+            w = ~w;
+        }
+        row.back() &= tail;
+    }
+
+    for (unsigned t = 1; t < m_num_threads; t++) {
+        m_workers.emplace_back([this, t] { worker(t); });
+    }
+}
+
+inline parallel_bfs::~parallel_bfs()
+{
+    m_stop = true;
+    m_sync.arrive_and_wait(); // workers see m_stop and exit, then get joined
+}
+
+// claims the unvisited open neighbours of thread t's share of the lists
+inline void parallel_bfs::top_down(unsigned t)
+{
+    const std::ptrdiff_t row_bits = m_stride * 64;
+    const std::ptrdiff_t deltas[] = { -1, 1, -row_bits, row_bits };
+
+    auto &out = m_next_lists[t];
+    out.clear();
+
+    // the lists are taken as one, so threads get even shares whoever
+    // found the cells
+    std::size_t n = 0;
+    for (const auto &l : m_lists) {
+        n += l.size();
+    }
+    std::size_t k = share_begin(t, n), end = share_end(t, n), offset = 0;
+
+    for (const auto &l : m_lists) {
+        for (; k < end && k - offset < l.size(); k++) {
+            const uint64_t id = l[k - offset];
+            for (const auto d : deltas) {
+                const uint64_t nid = id + d;
+                const word_t bit = word_t(1) << (nid % 64);
+                if (!(m_open[nid / 64] & bit)) {
+                    continue;
+                }
+
+                if (m_num_threads == 1) {
+                    if (!(m_visited[nid / 64] & bit)) {
+                        m_visited[nid / 64] |= bit;
+                        out.push_back(nid);
+                    }
+                    continue;
+                }
+
+                std::atomic_ref<word_t> visited(m_visited[nid / 64]);
+                if (visited.load(std::memory_order_relaxed) & bit) {
+                    continue;
+                }
+                if (!(visited.fetch_or(bit, std::memory_order_relaxed) & bit)) {
+                    out.push_back(nid);
+                }
+            }
+        }
+        offset += l.size();
+    }
+
+    m_counts[t] = out.size();
+}
+
+// sets the bits of thread t's list in the (all zero) frontier bitset
+inline void parallel_bfs::to_bitset(unsigned t)
+{
+    for (const uint64_t id : m_lists[t]) {
+        std::atomic_ref<word_t>(m_frontier[id / 64]).fetch_or(word_t(1) << (id % 64), std::memory_order_relaxed);
+    }
+}
+
+// next = (neighbours of frontier) & open & ~visited over thread t's rows
+inline void parallel_bfs::bottom_up(unsigned t)
+{
+    const std::size_t rows = m_row_hi - m_row_lo + 1;
+    const std::size_t first = (m_row_lo + share_begin(t, rows) + 1) * m_stride;
+    const std::size_t last = (m_row_lo + share_end(t, rows) + 1) * m_stride;
+
+    const std::ptrdiff_t S = m_stride;
+    const word_t *__restrict f = m_frontier.data();
+    const word_t *__restrict open = m_open.data();
+    word_t *__restrict visited = m_visited.data();
+    word_t *__restrict out = m_next.data();
+
+    std::size_t count = 0;
+    for (std::size_t i = first; i < last; i++) {
+        const word_t horiz = (f[i] << 1) | (f[i - 1] >> 63) | (f[i] >> 1) | (f[i + 1] << 63);
+        const word_t reached = (horiz | f[i - S] | f[i + S]) & open[i] & ~visited[i];
+        out[i] = reached;
+        visited[i] |= reached;
+        count += std::popcount(reached);
+    }
+
+    m_counts[t] = count;
+}
+
+// lists the frontier bits in thread t's rows, and clears both bitsets there
+inline void parallel_bfs::to_list(unsigned t)
+{
+    const std::size_t rows = m_row_hi - m_row_lo + 1;
+    const std::size_t first = (m_row_lo + share_begin(t, rows) + 1) * m_stride;
+    const std::size_t last = (m_row_lo + share_end(t, rows) + 1) * m_stride;
+
+    auto &out = m_lists[t];
+    out.clear();
+    for (std::size_t i = first; i < last; i++) {
+        for (word_t w = m_frontier[i]; w; w &= w - 1) {
+            out.push_back(i * 64 + std::countr_zero(w));
+        }
+        m_frontier[i] = 0;
+        m_next[i] = 0;
+    }
+}
+
+inline void parallel_bfs::run_phase(unsigned t)
+{
+    switch (m_phase) {
+        case phase::top_down:  top_down(t);  break;
+        case phase::to_bitset: to_bitset(t); break;
+        case phase::bottom_up: bottom_up(t); break;
+        case phase::to_list:   to_list(t);   break;
+    }
+}
+
+inline void parallel_bfs::worker(unsigned t)
+{
+    while (true) {
+        m_sync.arrive_and_wait(); // wait for a phase to start
+        if (m_stop) {
+            return;
+        }
+        run_phase(t);
+        m_sync.arrive_and_wait();
+    }
+}
+
+inline std::vector<std::size_t> parallel_bfs::distance_histogram(
+        const std::size_t col, const std::size_t row, const long max_steps)
+{
+    std::fill(m_visited.begin(), m_visited.end(), 0);
+    for (auto &l : m_lists) {
+        l.clear();
+    }
+    num_top_down = num_bottom_up = 0;
+
+    std::vector<std::size_t> hist;
+    const std::size_t start = word_idx(col, row);
+    if (!(m_open[start] & (word_t(1) << (col % 64)))) {
+        return hist;
+    }
+
+    m_visited[start] |= word_t(1) << (col % 64);
+    m_lists[0].push_back(start * 64 + col % 64);
+    hist.push_back(1);
+    m_row_lo = m_row_hi = row;
+    m_phase = phase::top_down;
+
+    const auto run = [this](phase p) {
+        m_phase = p;
+        m_sync.arrive_and_wait();
+        run_phase(0);
+        m_sync.arrive_and_wait();
+    };
+
+    for (long level = 1; level <= max_steps; level++) {
+        m_row_lo = m_row_lo ? m_row_lo - 1 : 0;
+        m_row_hi = std::min(m_row_hi + 1, m_height - 1);
+        const std::size_t band_words = (m_row_hi - m_row_lo + 1) * m_stride;
+        const std::size_t frontier = hist.back();
+
+        if (m_phase == phase::top_down && frontier * bottom_up_ratio > band_words) {
+            run(phase::to_bitset);
+            m_phase = phase::bottom_up;
+        } else if (m_phase == phase::bottom_up && frontier * top_down_ratio < band_words) {
+            run(phase::to_list);
+            m_phase = phase::top_down;
+        }
+
+        run(m_phase);
+        if (m_phase == phase::top_down) {
+            std::swap(m_lists, m_next_lists);
+            num_top_down++;
+        } else {
+            std::swap(m_frontier, m_next);
+            num_bottom_up++;
+        }
+
+        std::size_t added = 0;
+        for (const auto c : m_counts) {
+            added += c;
+        }
+        if (!added) {
+            break;
+        }
+        hist.push_back(added);
+    }
+
+    // leave the bitsets zero for the next search
+    if (m_phase == phase::bottom_up) {
+        run(phase::to_list);
+    }
+
+    return hist;
+}
+//}}}
+
+// vim: fdm=marker: